@@ -0,0 +1,340 @@
+#!/usr/bin/perl -w
+
+#
+#  bench.pl - Benchmark script for TECO-64 text editor.
+#
+#  @copyright 2021 Franklin P. Johnston / Nowwith Treble Software
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a
+#  copy of this software and associated documentation files (the "Software"),
+#  to deal in the Software without restriction, including without limitation
+#  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+#  and/or sell copies of the Software, and to permit persons to whom the
+#  Software is furnished to do so, subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in
+#  all copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+#  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+#  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+#  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+#  THE SOFTWARE.
+#
+################################################################################
+
+#
+#  Usage: bench.pl [--size=1M|100M|1G] [--runs=n] [--tolerance=pct]
+#                  [--update] [benchmark...]
+#
+#  Runs each benchmark macro (bench/*.tec, or just the ones specified) the
+#  specified number of times against the corpus created by corpus.pl, and
+#  records the minimum, median, and maximum elapsed times in
+#  bench/results-<size>.json. If there is a baseline file
+#  (bench/baseline-<size>.json), the results are compared to it, and the
+#  script exits with a non-zero status if any benchmark is slower than its
+#  baseline by more than the tolerance. Comparisons use the minimum time, as
+#  that is the least affected by other activity on the system. If --update is
+#  specified, the results are copied to the baseline file.
+#
+#  Each benchmark macro starts with header comments like the following:
+#
+#      ! TECO benchmark: <description> !
+#      ! Corpus: <file in corpus directory, or None> !
+#      ! Requirements: terminal !
+#
+#  The Requirements line is optional. Benchmarks that require a terminal are
+#  skipped if standard input and output are not both terminals.
+#
+
+use strict;
+use warnings;
+use version; our $VERSION = '1.0.0';
+
+use Carp;
+use Cwd qw(abs_path);
+use File::Basename;
+use Getopt::Long;
+use JSON::PP;
+use POSIX qw(strftime);
+use Time::HiRes qw(time);
+
+my $bench_dir = dirname(abs_path($0));
+my $root_dir  = dirname($bench_dir);
+my $teco      = "$root_dir/bin/teco";
+
+my $size      = '1M';
+my $runs      = 5;
+my $tolerance = 20;                     # Allowed slowdown, in percent
+my $slack     = 0.020;                  # Allowed slowdown, in seconds
+my $update    = 0;
+
+GetOptions(
+    'size=s'      => \$size,
+    'runs=i'      => \$runs,
+    'tolerance=i' => \$tolerance,
+    'update'      => \$update,
+) or croak 'Usage: bench.pl [--size=1M|100M|1G] [--runs=n] [--tolerance=pct] '
+         . "[--update] [benchmark...]\n";
+
+croak "Cannot find $teco; build TECO first\n" if !-x $teco;
+croak "Number of runs must be at least 1\n"   if $runs < 1;
+
+my $corpus_dir = "$bench_dir/corpus/$size";
+
+croak "Corpus directory $corpus_dir not found; run corpus.pl first\n"
+    if !-d $corpus_dir;
+
+my @files;
+
+if (@ARGV)
+{
+    @files = map { "$bench_dir/" . basename($_, '.tec') . '.tec' } @ARGV;
+}
+else
+{
+    @files = sort glob "$bench_dir/*.tec";
+}
+
+my $terminal = -t STDIN && -t STDOUT;
+
+local $ENV{TECO_LIBRARY} = "$root_dir/lib";
+
+chdir $corpus_dir or croak "Cannot change directory to $corpus_dir: $!\n";
+
+my %results = (
+    size       => $size,
+    runs       => $runs,
+    date       => strftime('%Y-%m-%dT%H:%M:%S', localtime),
+    benchmarks => {},
+);
+
+my $failures = 0;
+
+foreach my $file (@files)
+{
+    my $name   = basename($file, '.tec');
+    my %header = read_header($file);
+    my $result = { description => $header{benchmark} };
+
+    $results{benchmarks}{$name} = $result;
+
+    if ($header{corpus} ne 'None' && !-f $header{corpus})
+    {
+        $result->{skipped} = "missing corpus file $header{corpus}";
+    }
+    elsif ($header{requirements} =~ /terminal/msx && !$terminal)
+    {
+        $result->{skipped} = 'no terminal';
+    }
+
+    if (exists $result->{skipped})
+    {
+        printf "%-12s skipped (%s)\n", $name, $result->{skipped};
+
+        next;
+    }
+
+    my @times;
+
+    for (1 .. $runs)
+    {
+        my $elapsed = run_teco($file, $header{requirements});
+
+        if (!defined $elapsed)
+        {
+            $result->{error} = 'TECO error';
+            ++$failures;
+
+            last;
+        }
+
+        push @times, $elapsed;
+    }
+
+    unlink 'bench.out';
+
+    next if exists $result->{error};
+
+    @times = sort { $a <=> $b } @times;
+
+    $result->{median} = sprintf '%.4f', $times[$#times / 2];
+    $result->{min}    = sprintf '%.4f', $times[0];
+    $result->{max}    = sprintf '%.4f', $times[-1];
+
+    $result->{$_} += 0 for qw(median min max);
+}
+
+my $json = JSON::PP->new->pretty->canonical;
+
+write_json("$bench_dir/results-$size.json", \%results);
+
+my $baseline_file = "$bench_dir/baseline-$size.json";
+
+if ($update)
+{
+    write_json($baseline_file, \%results);
+
+    print "Updated $baseline_file\n";
+}
+elsif (-f $baseline_file)
+{
+    $failures += compare_results(read_json($baseline_file), \%results);
+}
+else
+{
+    print "No baseline file found; use --update to create one\n";
+}
+
+exit($failures ? 1 : 0);
+
+
+#
+#  Compare results to baseline, and print a report. Returns the number of
+#  benchmarks that regressed.
+#
+
+sub compare_results
+{
+    my ($baseline, $results) = @_;
+    my $regressions = 0;
+
+    printf "\n%-12s %10s %10s %8s\n", 'Benchmark', 'Baseline', 'Current',
+           'Change';
+
+    foreach my $name (sort keys %{ $results->{benchmarks} })
+    {
+        my $new = $results->{benchmarks}{$name};
+        my $old = $baseline->{benchmarks}{$name};
+
+        if (exists $new->{error})
+        {
+            printf "%-12s %10s %10s\n", $name, q{}, 'error';
+
+            next;
+        }
+        elsif (!defined $new->{min} || !defined $old || !defined $old->{min})
+        {
+            printf "%-12s %10s %10s\n", $name, $old->{min} // q{-},
+                   $new->{min} // 'skipped';
+
+            next;
+        }
+
+        my $change = $old->{min} ? ($new->{min} / $old->{min} - 1) * 100 : 0;
+        my $limit  = $old->{min} * (1 + $tolerance / 100) + $slack;
+        my $status = q{};
+
+        if ($new->{min} > $limit)
+        {
+            $status = '  REGRESSION';
+            ++$regressions;
+        }
+
+        printf "%-12s %10.4f %10.4f %+7.1f%%%s\n", $name, $old->{min},
+               $new->{min}, $change, $status;
+    }
+
+    return $regressions;
+}
+
+
+#
+#  Read header comments from benchmark file.
+#
+
+sub read_header
+{
+    my ($file) = @_;
+    my %header = ( benchmark => q{}, corpus => 'None', requirements => q{} );
+
+    open my $fh, '<', $file or croak "Cannot open $file: $!\n";
+
+    while (my $line = <$fh>)
+    {
+        last if $line !~ /^!\s+(?:TECO\s+)?(\w+):\s+(.*?)\s+!/msx;
+
+        $header{lc $1} = $2;
+    }
+
+    close $fh or croak "Cannot close $file: $!\n";
+
+    return %header;
+}
+
+
+#
+#  Read JSON file.
+#
+
+sub read_json
+{
+    my ($file) = @_;
+
+    open my $fh, '<', $file or croak "Cannot open $file: $!\n";
+
+    local $/ = undef;
+
+    my $text = <$fh>;
+
+    close $fh or croak "Cannot close $file: $!\n";
+
+    return $json->decode($text);
+}
+
+
+#
+#  Run TECO with benchmark macro, and return elapsed time in seconds, or undef
+#  if TECO exited with an error or printed an error message.
+#
+
+sub run_teco
+{
+    my ($file, $requirements) = @_;
+    my @args = ($teco, '-n', '-X', '-E', $file);
+
+    unlink 'bench.out';
+
+    my $start = time;
+
+    if ($requirements =~ /terminal/msx)
+    {
+        return system(@args) == 0 ? time - $start : undef;
+    }
+
+    open my $fh, q{-|}, @args or croak "Cannot run $teco: $!\n";
+
+    my $output = do { local $/ = undef; <$fh> } // q{};
+
+    my $ok = close $fh;
+    my $elapsed = time - $start;
+
+    if (!$ok || $output =~ /^\?/msx)
+    {
+        print $output;
+
+        return;
+    }
+
+    return $elapsed;
+}
+
+
+#
+#  Write JSON file.
+#
+
+sub write_json
+{
+    my ($file, $data) = @_;
+
+    open my $fh, '>', $file or croak "Cannot open $file: $!\n";
+
+    print {$fh} $json->encode($data);
+
+    close $fh or croak "Cannot close $file: $!\n";
+
+    return;
+}
@@ -0,0 +1,199 @@
+#!/usr/bin/perl -w
+
+#
+#  corpus.pl - Generate test files for TECO-64 benchmarks.
+#
+#  @copyright 2021 Franklin P. Johnston / Nowwith Treble Software
+#
+#  Permission is hereby granted, free of charge, to any person obtaining a
+#  copy of this software and associated documentation files (the "Software"),
+#  to deal in the Software without restriction, including without limitation
+#  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+#  and/or sell copies of the Software, and to permit persons to whom the
+#  Software is furnished to do so, subject to the following conditions:
+#
+#  The above copyright notice and this permission notice shall be included in
+#  all copies or substantial portions of the Software.
+#
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+#  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+#  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+#  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+#  THE SOFTWARE.
+#
+################################################################################
+
+#
+#  Usage: corpus.pl [--size=1M|100M|1G] [--output=dir]
+#
+#  Creates the following files in the output directory (by default,
+#  bench/corpus/<size>), each of approximately the specified size:
+#
+#      source.txt    Source-like text with LF line endings.
+#      crlf.txt      The same text with CR/LF line endings.
+#      paged.txt     The same text, with a form feed after every 60 lines.
+#      longline.txt  Lines of 10,000 to 100,000 characters.
+#
+#  The files are generated with a fixed pseudo-random sequence, so that they
+#  are identical on every system and for every version of Perl. Existing
+#  files of the right size are not regenerated.
+#
+
+use strict;
+use warnings;
+use version; our $VERSION = '1.0.0';
+
+use Carp;
+use Cwd qw(abs_path);
+use File::Basename;
+use File::Path qw(make_path);
+use Getopt::Long;
+
+my %sizes = (
+    '1M'   => 1024 * 1024,
+    '100M' => 100 * 1024 * 1024,
+    '1G'   => 1024 * 1024 * 1024,
+);
+
+my $size   = '1M';
+my $output = q{};
+
+GetOptions(
+    'size=s'   => \$size,
+    'output=s' => \$output,
+);
+
+croak "Invalid corpus size: $size\n" if !exists $sizes{$size};
+
+if ( !length $output )
+{
+    $output = dirname( abs_path($0) ) . "/corpus/$size";
+}
+
+make_path($output);
+
+my $nbytes = $sizes{$size};
+
+my @words = qw(
+  int char long unsigned const static struct return if else while for
+  buffer pos len size count data text next prev page line search match
+  alloc free expand shrink insert delete append yank write read flag
+);
+
+my $seed;    # State for pseudo-random number generator
+
+make_file( 'source.txt',   \&source_line, q{},  "\n" );
+make_file( 'crlf.txt',     \&source_line, q{},  "\r\n" );
+make_file( 'paged.txt',    \&source_line, "\f", "\n" );
+make_file( 'longline.txt', \&long_line,   q{},  "\n" );
+
+exit;
+
+#
+#  Create file, unless it already exists with the right size.
+#
+
+sub make_file
+{
+    my ( $name, $make_line, $ff, $eol ) = @_;
+    my $file = "$output/$name";
+
+    return if -f $file && -s $file == $nbytes;
+
+    print "Creating $file\n";
+
+    open my $fh, '>', $file or croak "Can't create $file: $!\n";
+
+    $seed = 12_345;
+
+    my $total = 0;
+    my $nlines = 0;
+    my $chunk = q{};
+
+    while ( $total < $nbytes )
+    {
+        my $line = $make_line->() . $eol;
+
+        if ( length $ff && ++$nlines % 60 == 0 )
+        {
+            $line .= $ff;
+        }
+
+        if ( $total + length $line > $nbytes )
+        {
+            $line = substr $line, 0, $nbytes - $total;
+        }
+
+        $chunk .= $line;
+        $total += length $line;
+
+        if ( length $chunk >= 65_536 )
+        {
+            print {$fh} $chunk or croak "Can't write $file: $!\n";
+
+            $chunk = q{};
+        }
+    }
+
+    print {$fh} $chunk or croak "Can't write $file: $!\n";
+
+    close $fh or croak "Can't close $file: $!\n";
+
+    return;
+}
+
+#
+#  Return next pseudo-random number in range [0, n).
+#
+
+sub next_random
+{
+    my ($n) = @_;
+
+    $seed = ( $seed * 1_103_515_245 + 12_345 ) % 2_147_483_648;
+
+    return int( ( $seed >> 8 ) % $n );
+}
+
+#
+#  Create a line that looks something like C source code.
+#
+
+sub source_line
+{
+    my $indent = q{ } x ( 4 * next_random(4) );
+    my $nwords = next_random(10);
+    my $line   = $indent;
+
+    for ( 1 .. $nwords )
+    {
+        $line .= $words[ next_random( scalar @words ) ];
+        $line .= next_random(3) ? q{ } : '_';
+    }
+
+    if ( $nwords != 0 )
+    {
+        $line .= next_random(4) ? q{;} : '(' . next_random(1000) . ');';
+    }
+
+    return $line;
+}
+
+#
+#  Create a very long line.
+#
+
+sub long_line
+{
+    my $len  = 10_000 + next_random(90_000);
+    my $line = q{};
+
+    while ( length $line < $len )
+    {
+        $line .= $words[ next_random( scalar @words ) ] . q{ };
+    }
+
+    return substr $line, 0, $len;
+}
@@ -315,6 +315,8 @@ static const struct cmd_table f_table[] =
     ENTRY('m',     scan_FM,         exec_FM,         NO_ARGS),
     ENTRY('N',     scan_FN,         exec_FN,         NO_ARGS),
     ENTRY('n',     scan_FN,         exec_FN,         NO_ARGS),
+    ENTRY('P',     scan_FP,         exec_FP,         NO_ARGS),
+    ENTRY('p',     scan_FP,         exec_FP,         NO_ARGS),
     ENTRY('Q',     scan_EQ,         exec_FQ,         NO_ARGS),
     ENTRY('q',     scan_EQ,         exec_FQ,         NO_ARGS),
     ENTRY('R',     scan_FR,         exec_FR,         NO_ARGS),
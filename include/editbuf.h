@@ -73,10 +73,30 @@ extern bool ebuf_changed;
 
 extern int add_ebuf(int c);
 
+// Replace contents of buffer with a block of text, taking ownership of the
+// block, which must have been allocated with alloc_mem(). len is the no. of
+// bytes of text, and size is the allocated size of the block.
+
+extern void attach_ebuf(char *block, uint_t len, uint_t size);
+
 //  Delete nbytes at dot. Argument can be positive or negative.
 
 extern void delete_ebuf(int_t nbytes);
 
+// Detach text from buffer without copying it, leaving buffer empty. Returns
+// a NUL-terminated block of t.Z + 1 bytes, which the caller must free.
+
+extern char *detach_ebuf(void);
+
+// Get pointer to contiguous text in buffer at position relative to dot.
+// nbytes is the no. of bytes wanted, and is reduced to the no. of bytes
+// that can be accessed at the pointer returned.
+//
+// Returns: pointer to text, or NULL if position is beyond the beginning or
+//          end of buffer.
+
+extern const char *getblock_ebuf(int_t relpos, uint_t *nbytes);
+
 // Get ASCII value of character in buffer at position relative to dot.
 //
 // Examples of values of n:
@@ -52,6 +52,8 @@ union e0_flag
         uint init     : 1;      ///< TECO is initializing
         uint i_redir  : 1;      ///< stdin has been redirected
         uint o_redir  : 1;      ///< stdout has been redirected
+        uint batch    : 1;      ///< Batch mode (no terminal setup)
+        uint each     : 1;      ///< Processing file for --each option
     };
 };
 
@@ -125,9 +127,12 @@ union e3_flag
         uint CR_out  : 1;       ///< Convert LF to CR/LF writing output
         uint noin    : 1;       ///< Don't type input to log file
         uint noout   : 1;       ///< Don't type output to log file
-        uint         : 1;       ///< (unused)
+        uint compress: 1;       ///< Compress pages stored in memory
         uint keepnul : 1;       ///< Discard NUL chrs. in input files
         uint CR_type : 1;       ///< Convert LF to CR/LF on type out
+        uint compile : 1;       ///< Write compiled EI command files
+        uint profile : 1;       ///< Profile command execution
+        uint ring    : 1;       ///< Record commands in trace ring
     };
 };
 
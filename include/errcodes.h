@@ -30,8 +30,12 @@
 
 #define _ERRCODES_H
 
+#define ERR_MSG_SIZE    512         ///< Size of last error message
+
 extern int last_error;
 
+extern char last_message[];
+
 ///  @enum   errcodes
 ///  @brief  Definitions of TECO error messages.
 
@@ -279,6 +279,8 @@ extern bool scan_FM(struct cmd *cmd);
 
 extern bool scan_FN(struct cmd *cmd);
 
+extern bool scan_FP(struct cmd *cmd);
+
 extern bool scan_FR(struct cmd *cmd);
 
 extern bool scan_FS(struct cmd *cmd);
@@ -494,6 +496,8 @@ extern void exec_FM(struct cmd *cmd);
 
 extern void exec_FN(struct cmd *cmd);
 
+extern void exec_FP(struct cmd *cmd);
+
 extern void exec_FQ(struct cmd *cmd);
 
 extern void exec_FR(struct cmd *cmd);
@@ -623,6 +627,8 @@ extern void exec_macro(tbuffer *macro, struct cmd *cmd);
 
 extern void exec_insert(const char *buf, uint_t len);
 
+extern const struct cmd_table *find_cmd(int c1, int c2);
+
 extern int find_eg(char *buf);
 
 extern bool next_page(int_t start, int_t end, bool ff, bool yank);
@@ -99,6 +99,8 @@ extern void close_output(uint stream);
 
 extern struct ifile *find_command(const char *name, uint stream, bool colon);
 
+extern void flush_log(void);
+
 extern int get_wild(void);
 
 extern char *init_filename(const char *src, uint_t len, bool colon);
@@ -108,6 +110,9 @@ extern bool open_command(const char *name, uint stream, bool colon,
 
 extern struct ifile *open_input(const char *name, uint stream, bool colon);
 
+extern bool open_macro(const char *name, uint stream, bool colon,
+                       tbuffer *text);
+
 extern struct ofile *open_output(const char *name, uint stream, bool colon,
                                  int c);
 
@@ -0,0 +1,132 @@
+///
+///  @file    flow.h
+///  @brief   Header file for flow control cache.
+///
+///  @copyright 2019-2021 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#if     !defined(_FLOW_H)
+
+#define _FLOW_H
+
+#include <stdbool.h>            //lint !e451
+
+#include <sys/stat.h>           //lint !e451
+
+#include "teco.h"
+
+
+///  @enum   flow_type
+///  @brief  Type of forward skip through command string.
+
+enum flow_type
+{
+    FLOW_LOOP = 1,                  ///< Flow to end of loop
+    FLOW_IF   = 2,                  ///< Flow to end of conditional
+    FLOW_ELSE = 3                   ///< Flow to else clause or end
+};
+
+///  @struct  flow
+///  @brief   Forward skip from a flow command to its matching character.
+
+struct flow
+{
+    enum flow_type type;            ///< Type of skip
+    uint_t pos;                     ///< Starting position in command string
+    uint_t line;                    ///< Starting line number
+    uint nparens;                   ///< Starting parenthesis count
+    int loops;                      ///< Net change in loop depth
+    int ifs;                        ///< Net change in conditional depth
+};
+
+///  @struct  op
+///  @brief   Pre-scanned command, or text operands for a command, at a given
+///           position in a command string.
+
+struct op
+{
+    const struct cmd_table *entry;  ///< Command table entry (NULL if none)
+    uint_t next;                    ///< Position following command characters
+    char c1;                        ///< 1st command character
+    char c2;                        ///< 2nd command character
+    uint_t end;                     ///< Position following text (0 if none)
+    uint_t lines;                   ///< No. of lines in text
+    uint_t text1;                   ///< Offset of 1st text string
+    uint_t len1;                    ///< Length of 1st text string
+    uint_t text2;                   ///< Offset of 2nd text string
+    uint_t len2;                    ///< Length of 2nd text string
+    int delim;                      ///< Default text delimiter
+    int ntexts;                     ///< No. of text strings
+    bool atsign;                    ///< @ modifier was used
+    bool etext;                     ///< E1 flag allowed paired delimiters
+    bool counting;                  ///< true if counting lines
+};
+
+///  @struct  tag
+///  @brief   Location of tag in command string.
+
+struct tag
+{
+    const char *text;               ///< Tag text (NULL if unused entry)
+    uint_t len;                     ///< Length of tag text
+    uint_t pos;                     ///< Position following tag
+    uint_t line;                    ///< Line number of tag
+    uint loop;                      ///< Loop depth at tag
+    uint ifs;                       ///< Conditional depth at tag
+    bool dup;                       ///< true if tag occurs more than once
+};
+
+// Flow cache functions
+
+extern void add_tag(const struct tag *tag);
+
+extern void close_flow(tbuffer *macro, const char *file);
+
+extern void end_tags(uint_t loop_end);
+
+extern void exit_flow(void);
+
+extern bool find_flow(struct flow *flow);
+
+extern struct op *find_op(uint_t pos, bool create);
+
+extern bool find_tags(uint_t *loop_end);
+
+extern const struct tag *get_tag(const char *text, uint_t len);
+
+extern void keep_flow(const tbuffer *macro, const char *file,
+                      const struct stat *source);
+
+extern bool load_flow(tbuffer *macro, const char *file,
+                      const struct stat *source);
+
+extern void open_flow(const tbuffer *macro);
+
+extern void release_flow(void);
+
+extern void reset_flow(const char *data);
+
+extern void start_tags(void);
+
+extern void store_flow(const struct flow *flow);
+
+#endif  // !defined(_FLOW_H)
@@ -70,6 +70,8 @@ static const char * const help_text[] =
     "",
     "  -A, --argument         Specify n or m,n arguments for command file.",
     "  -E, --execute=xyz      Execute TECO macro in file 'xyz'.",
+    "  -J, --jobs=n           Use 'n' worker processes for --each.",
+    "  -W, --each=abc         Execute macro on each file matching 'abc'.",
     "  -T, --text=xyz         Store text 'xyz' in edit buffer.",
     "",
     "Initialization options:",
@@ -88,15 +90,19 @@ static const char * const help_text[] =
     "",
     "Debug options:",
     "",
+    "  -B, --ring=xyz         Trace commands in ring, dumping it to file 'xyz'.",
     "  -F, --formfeed         Enables FF as a page delimiter.",
     "  -f, --noformfeed       Disables FF as a page delimiter.",
     "  -K, --keys=xyz         Saves keystrokes in file 'xyz'.",
     "  -L, --log=xyz          Saves input and output in log file 'xyz'.",
+    "  -P, --profile=xyz      Profile commands, writing results to file 'xyz'.",
+    "  -U, --stats            Print performance counters on exit.",
     "  -Z, --zero=n           Enable syntax restrictions by setting E2 to 'n'.",
     "",
     "Miscellaneous options:",
     "",
     "  -n, --nodefaults       Disable all defaults (equivalent to -c -i -m -v).",
+    "  -Q, --batch            Run without terminal setup, and buffer all output.",
     "  -H, --help             Print this help message.",
     "  -X, --exit             Exit from TECO after executing all command-line options.",
     NULL
@@ -108,20 +114,26 @@ static const char * const help_text[] =
 enum option_t
 {
     OPTION_A = 'A',
+    OPTION_B = 'B',
     OPTION_C = 'C',
     OPTION_D = 'D',
     OPTION_E = 'E',
     OPTION_F = 'F',
     OPTION_H = 'H',
     OPTION_I = 'I',
+    OPTION_J = 'J',
     OPTION_K = 'K',
     OPTION_L = 'L',
     OPTION_M = 'M',
     OPTION_O = 'O',
+    OPTION_P = 'P',
+    OPTION_Q = 'Q',
     OPTION_R = 'R',
     OPTION_S = 'S',
     OPTION_T = 'T',
+    OPTION_U = 'U',
     OPTION_V = 'V',
+    OPTION_W = 'W',
     OPTION_X = 'X',
     OPTION_Z = 'Z',
     OPTION_c = 'c',
@@ -137,7 +149,7 @@ enum option_t
 ///  @var optstring
 ///  String of short options parsed by getopt_long().
 
-static const char * const optstring = ":A:CDE:FHI::K:L:MO:RS:T:V::XZ::cfimnorv";
+static const char * const optstring = ":A:B::CDE:FHI::J:K:L:MO:P::QRS:T:UV::W:XZ::cfimnorv";
 
 ///  @var    long_options[]
 ///  @brief  Table of command-line options parsed by getopt_long().
@@ -145,20 +157,26 @@ static const char * const optstring = ":A:CDE:FHI::K:L:MO:RS:T:V::XZ::cfimnorv";
 static const struct option long_options[] =
 {
     { "argument",       required_argument,  NULL,  'A'    },
+    { "ring",           optional_argument,  NULL,  'B'    },
     { "create",         no_argument,        NULL,  'C'    },
     { "display",        no_argument,        NULL,  'D'    },
     { "execute",        required_argument,  NULL,  'E'    },
     { "formfeed",       no_argument,        NULL,  'F'    },
     { "help",           no_argument,        NULL,  'H'    },
     { "initialize",     optional_argument,  NULL,  'I'    },
+    { "jobs",           required_argument,  NULL,  'J'    },
     { "keys",           required_argument,  NULL,  'K'    },
     { "log",            required_argument,  NULL,  'L'    },
     { "memory",         no_argument,        NULL,  'M'    },
     { "output",         required_argument,  NULL,  'O'    },
+    { "profile",        optional_argument,  NULL,  'P'    },
+    { "batch",          no_argument,        NULL,  'Q'    },
     { "read-only",      no_argument,        NULL,  'R'    },
     { "scroll",         required_argument,  NULL,  'S'    },
     { "text",           required_argument,  NULL,  'T'    },
+    { "stats",          no_argument,        NULL,  'U'    },
     { "vtedit",         optional_argument,  NULL,  'V'    },
+    { "each",           required_argument,  NULL,  'W'    },
     { "exit",           no_argument,        NULL,  'X'    },
     { "zero",           optional_argument,  NULL,  'Z'    },
     { "nocreate",       no_argument,        NULL,  'c'    },
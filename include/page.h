@@ -37,7 +37,10 @@ extern uint page_count(void);
 
 extern void page_flush(FILE *fp);
 
-extern bool page_forward(FILE *fp, int_t start, int_t end, bool ff);
+extern bool page_forward(FILE *fp, int_t start, int_t end, bool ff,
+                         bool yank);
+
+extern uint page_seek(uint page, bool ff);
 
 extern void reset_pages(uint stream);
 
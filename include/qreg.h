@@ -43,6 +43,7 @@ struct qreg
 {
     int_t n;                        ///< Q-register numeric value
     tbuffer text;                   ///< Q-register text storage
+    bool shared;                    ///< Text may be shared with others
 };
 
 ///  @var     QNAMES
@@ -59,6 +60,8 @@ struct qreg
 
 extern void append_qchr(int qindex, int c);
 
+extern void append_qtext(int qindex, const char *text, uint_t len);
+
 extern void delete_qtext(int qindex);
 
 extern uint_t get_qall(void);
@@ -73,6 +76,8 @@ extern struct qreg *get_qreg(int qindex);
 
 extern uint_t get_qsize(int qindex);
 
+extern tbuffer hold_qtext(int qindex);
+
 extern void init_qreg(void);
 
 extern void pop_qlocal(void);
@@ -85,6 +90,8 @@ extern void push_qlocal(void);
 
 extern bool push_qreg(int qindex);
 
+extern void release_qtext(void);
+
 extern void reset_macro(void);
 
 extern void reset_qreg(void);
@@ -0,0 +1,45 @@
+///
+///  @file    report.h
+///  @brief   Header file for timing and report functions shared by the macro
+///           profiler and the command trace ring.
+///
+///  @copyright 2019-2021 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#if     !defined(_REPORT_H)
+
+#define _REPORT_H
+
+#include <stdio.h>              //lint !e451
+
+typedef unsigned long long nsec_t;      ///< Elapsed time in nanoseconds
+
+
+// Report functions
+
+extern nsec_t get_nsec(void);
+
+extern void print_report(FILE *fp, const char *format, ...);
+
+extern void set_report(char **file, const char *name);
+
+#endif  // !defined(_REPORT_H)
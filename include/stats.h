@@ -0,0 +1,104 @@
+///
+///  @file    stats.h
+///  @brief   Header file for TECO performance counters.
+///
+///  @copyright 2019-2021 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#if     !defined(_STATS_H)
+
+#define _STATS_H
+
+#include <stdbool.h>            //lint !e451
+
+
+///  @enum    stat_type
+///  @brief   Performance counters. The order of these must match the names
+///           in stats.c, and is also the order used by the n::EJ command.
+
+enum stat_type
+{
+    STAT_NONE,                      ///< (not used; 0::EJ returns count)
+    STAT_GAP_MOVES,                 ///< No. of edit buffer gap moves
+    STAT_GAP_BYTES,                 ///< No. of bytes moved across gap
+    STAT_RESIZES,                   ///< No. of edit buffer resizes
+    STAT_RESIZE_BYTES,              ///< No. of bytes reallocated
+    STAT_ADDS,                      ///< No. of add_ebuf() calls
+    STAT_DELETES,                   ///< No. of delete_ebuf() calls
+    STAT_PAGES_MADE,                ///< No. of pages made from edit buffer
+    STAT_PAGES_COPIED,              ///< No. of pages copied to edit buffer
+    STAT_PAGES_WRITTEN,             ///< No. of pages written to file
+    STAT_READ,                      ///< Bytes read (primary input)
+    STAT_READ_SECONDARY,            ///< Bytes read (secondary input)
+    STAT_READ_QREGISTER,            ///< Bytes read (EQ input)
+    STAT_READ_INDIRECT,             ///< Bytes read (EI input)
+    STAT_WRITE,                     ///< Bytes written (primary output)
+    STAT_WRITE_SECONDARY,           ///< Bytes written (secondary output)
+    STAT_WRITE_QREGISTER,           ///< Bytes written (E% output)
+    STAT_WRITE_LOG,                 ///< Bytes written (EL output)
+    STAT_SEARCH_TRIES,              ///< No. of search positions tried
+    STAT_SEARCH_MATCHES,            ///< No. of search matches
+    STAT_ALLOCS,                    ///< No. of alloc_mem() calls
+    STAT_ALLOC_BYTES,               ///< No. of bytes allocated
+    STAT_EXPANDS,                   ///< No. of expand_mem() calls
+    STAT_EXPAND_BYTES,              ///< No. of bytes added by expand_mem()
+    STAT_MEM,                       ///< Current bytes (edit buffer)
+    STAT_MEM_PAGE,                  ///< Current bytes (stored pages)
+    STAT_MEM_QREG,                  ///< Current bytes (Q-register text)
+    STAT_MEM_CBUF,                  ///< Current bytes (command buffer)
+    STAT_MEM_SEARCH,                ///< Current bytes (search string)
+    STAT_PEAK,                      ///< Peak bytes (edit buffer)
+    STAT_PEAK_PAGE,                 ///< Peak bytes (stored pages)
+    STAT_PEAK_QREG,                 ///< Peak bytes (Q-register text)
+    STAT_PEAK_CBUF,                 ///< Peak bytes (command buffer)
+    STAT_PEAK_SEARCH,               ///< Peak bytes (search string)
+    STAT_MAX                        ///< No. of counters
+};
+
+///  @enum    mem_tag
+///  @brief   Subsystems whose memory usage is tracked. The order of these
+///           must match the STAT_MEM and STAT_PEAK counters.
+
+enum mem_tag
+{
+    MEM_EBUF,                       ///< Edit buffer
+    MEM_PAGE,                       ///< Stored pages
+    MEM_QREG,                       ///< Q-register text
+    MEM_CBUF,                       ///< Command buffer
+    MEM_SEARCH                      ///< Search string
+};
+
+// Global variables
+
+extern unsigned long long stats[];
+
+// Performance counter functions
+
+extern void exit_stats(void);
+
+extern long long get_stat(int n);
+
+extern void set_stats(bool enable);
+
+extern void track_mem(enum mem_tag tag, uint_t oldsize, uint_t newsize);
+
+#endif  // !defined(_STATS_H)
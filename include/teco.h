@@ -93,7 +93,8 @@ enum
 {
     MAIN_NORMAL,                    ///< Normal main loop entry
     MAIN_ERROR,                     ///< Error entry
-    MAIN_CTRLC                      ///< CTRL/C or abort entry
+    MAIN_CTRLC,                     ///< CTRL/C or abort entry
+    MAIN_EXIT                       ///< EX command for --each option
 };
 
 
@@ -155,6 +156,8 @@ extern void *alloc_mem(uint_t size);
 
 extern tbuffer alloc_tbuf(uint_t size);
 
+extern void append_tbuf(tbuffer *tbuf, const char *data, uint_t len);
+
 extern tstring build_string(const char *src, uint_t len);
 
 extern bool check_loop(void);
@@ -203,6 +206,8 @@ extern uint getloop_base(void);
 
 extern uint getloop_depth(void);
 
+extern uint getmacro_depth(void);
+
 extern uint_t getloop_start(void);
 
 extern void init_env(void);
@@ -211,6 +216,8 @@ extern void init_options(int argc, const char * const argv[]);
 
 extern void print_flag(int_t flag);
 
+extern void reset_teco(void);
+
 extern void setif_depth(uint depth);
 
 extern void setloop_depth(uint depth);
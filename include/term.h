@@ -87,4 +87,6 @@ extern void retype_line(uint_t pos);
 
 extern void type_out(int c);
 
+extern void type_text(const char *text, uint_t len);
+
 #endif  // !defined(_TERM_H)
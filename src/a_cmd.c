@@ -37,6 +37,7 @@
 #include "estack.h"
 #include "exec.h"
 #include "file.h"
+#include "stats.h"
 
 
 ///
@@ -114,6 +115,8 @@ bool append_line(void)
 
     while ((c = next) != EOF)
     {
+        ++stats[STAT_READ + istream];
+
         next = fgetc(ifile->fp);
 
         if (c == NUL && !f.e3.keepnul)  // Discard NUL chrs. if necessary
@@ -34,6 +34,7 @@
 #include "eflags.h"
 #include "errcodes.h"
 #include "exec.h"
+#include "stats.h"
 #include "term.h"
 
 
@@ -121,6 +122,8 @@ void exit_cbuf(void)
 
     if (root != NULL && root->data != NULL)
     {
+        track_mem(MEM_CBUF, root->size, (uint_t)0);
+
         root->size = 0;
         root->pos  = 0;
         root->len  = 0;
@@ -147,6 +150,8 @@ void init_cbuf(void)
     root->size = KB;
     root->data = alloc_mem(root->size);
 
+    track_mem(MEM_CBUF, (uint_t)0, root->size);
+
     cbuf = root;
 }
 
@@ -195,9 +200,14 @@ void store_cbuf(int c)
         cbuf->size /= KB;
         cbuf->size *= KB;
 
-        char *newbuf = expand_mem(cbuf->data, cbuf->size, KB);
+        // Double the size each time, so that building a long command string
+        // doesn't require a reallocation for every 1 KB added.
+
+        char *newbuf = expand_mem(cbuf->data, cbuf->size, cbuf->size);
+
+        track_mem(MEM_CBUF, cbuf->size, cbuf->size * 2);
 
-        cbuf->size += KB;
+        cbuf->size *= 2;
         cbuf->data = newbuf;
     }
 
@@ -29,10 +29,15 @@
 #include <string.h>
 
 #include "teco.h"
+#include "editbuf.h"
 #include "eflags.h"
 #include "errcodes.h"
 #include "estack.h"
 #include "exec.h"
+#include "flow.h"
+#include "profile.h"
+#include "qreg.h"
+#include "ring.h"
 #include "term.h"
 
 #include "cbuf.h"
@@ -70,13 +75,48 @@ uint_t cmd_line;                    ///< Line number in current command/macro
 
 // Local functions
 
+static void check_ctrl_c(void);
+
 static bool echo_cmd(int c);
 
+#if     !defined(NOFUSE)
+
+static bool exec_idiom(struct cmd *cmd, int c);
+
+#endif
+
+static void parse_texts(struct cmd *cmd, int ntexts, int delim);
+
 static inline const struct cmd_table *scan_cmd(struct cmd *cmd, int c);
 
 static void scan_text(int delim, tstring *text);
 
 
+///
+///  @brief    Check to see if user typed CTRL/C during execution.
+///
+///  @returns  Nothing (returns to main loop if command aborted).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void check_ctrl_c(void)
+{
+    if (f.e0.ctrl_c)
+    {
+        if (f.et.ctrl_c)
+        {
+            f.et.ctrl_c = false;
+        }
+        else
+        {
+            f.e0.ctrl_c = false;
+
+            throw(E_XAB);
+        }
+    }
+}
+
+
 ///
 ///  @brief    Check to see if we want to echo current command/character.
 ///
@@ -188,6 +228,19 @@ void exec_cmd(struct cmd *cmd)
             continue;
         }
 
+#if     !defined(NOFUSE)
+
+        // If we're between commands, and not tracing, then see if we can
+        // execute a common command sequence in one step.
+
+        if (x.level == x.base && f.trace.flag == 0 && f.e0.exec
+            && exec_idiom(cmd, c))
+        {
+            continue;
+        }
+
+#endif
+
         const struct cmd_table *entry;
 
         // The specific check for a space is an optimization which was found
@@ -201,7 +254,19 @@ void exec_cmd(struct cmd *cmd)
 
         if (entry->exec != NULL && f.e0.exec)
         {
-            (*entry->exec)(cmd);
+            if (f.e3.ring)              // Recording commands?
+            {
+                record_ring(cmd);
+            }
+
+            if (f.e3.profile)           // Profiling commands?
+            {
+                exec_prof(entry->exec, cmd);
+            }
+            else
+            {
+                (*entry->exec)(cmd);
+            }
 
             // We normally reset the command block after every command we
             // execute. However, '[', ']', and '!' pass through m and n
@@ -231,19 +296,7 @@ void exec_cmd(struct cmd *cmd)
             *cmd = null_cmd;
         }
 
-        if (f.e0.ctrl_c)
-        {
-            if (f.et.ctrl_c)
-            {
-                f.et.ctrl_c = false;
-            }
-            else
-            {
-                f.e0.ctrl_c = false;
-
-                throw(E_XAB);
-            }
-        }
+        check_ctrl_c();
     }
 
     // Here to make sure that all conditionals, loops, and parenthetical
@@ -266,6 +319,276 @@ void exec_cmd(struct cmd *cmd)
 }
 
 
+#if     !defined(NOFUSE)
+
+///
+///  @brief    Execute common command sequences (0J, 0L, L, HK, HXq, QaUb, and
+///            %q) without going through the expression stack, and without
+///            returning to exec_cmd() between commands. The same scan and
+///            execution functions are called as for the individual commands,
+///            so the results (including any errors) are identical.
+///
+///  @returns  true if idiom executed, false if no match.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool exec_idiom(struct cmd *cmd, int c)
+{
+    assert(cmd != NULL);
+
+    if (cmd->m_set || cmd->n_set || cmd->h || cmd->ctrl_y || cmd->colon
+        || cmd->dcolon || cmd->atsign || f.e3.profile || f.e3.ring)
+    {
+        return false;
+    }
+
+    int c2;
+
+    switch (c)
+    {
+        case '0':                       // 0J or 0L
+            c2 = peek_cbuf();
+
+            if (c2 != 'J' && c2 != 'j' && c2 != 'L' && c2 != 'l')
+            {
+                return false;
+            }
+
+            next_cbuf();
+
+            cmd->c1    = (char)c2;
+            cmd->n_set = true;
+            cmd->n_arg = 0;
+
+            break;
+
+        case 'H':                       // HK or HXq
+        case 'h':
+            c2 = peek_cbuf();
+
+            if (c2 != 'K' && c2 != 'k' && c2 != 'X' && c2 != 'x')
+            {
+                return false;
+            }
+
+            next_cbuf();
+
+            cmd->c1    = (char)c2;
+            cmd->h     = true;
+            cmd->m_set = true;
+            cmd->m_arg = t.B;
+            cmd->n_set = true;
+            cmd->n_arg = t.Z;
+
+            break;
+
+        case 'L':                       // L
+        case 'l':
+        case '%':                       // %q
+            cmd->c1 = (char)c;
+
+            break;
+
+        case 'Q':                       // Qa, optionally followed by Ub
+        case 'q':
+            cmd->c1 = (char)c;
+
+            scan_qreg(cmd);
+
+            int_t n = get_qnum(cmd->qindex);
+
+            c2 = peek_cbuf();
+
+            if (c2 != 'U' && c2 != 'u')
+            {
+                push_x(n, X_OPERAND);
+
+                cmd->qlocal = false;    // Same as scan_Q()
+
+                return true;
+            }
+
+            next_cbuf();
+
+            *cmd = null_cmd;
+
+            cmd->c1    = (char)c2;
+            cmd->n_set = true;
+            cmd->n_arg = n;
+
+            break;
+
+        default:
+            return false;
+    }
+
+    const struct cmd_table *entry = &cmd_table[(uchar)cmd->c1];
+
+    if (!(*entry->scan)(cmd))
+    {
+        (*entry->exec)(cmd);
+    }
+
+    *cmd = null_cmd;
+
+    check_ctrl_c();
+
+    return true;
+}
+
+#endif
+
+
+///
+///  @brief    Find command table entry for command previously decoded by
+///            scan_cmd() (used when loading compiled command files).
+///
+///  @returns  Table entry, or NULL if invalid command.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+const struct cmd_table *find_cmd(int c1, int c2)
+{
+    const struct cmd_table *entry;
+
+    if (c1 == 'E' || c1 == 'e')
+    {
+        if ((uint)c2 >= e_max)
+        {
+            return NULL;
+        }
+
+        entry = &e_table[c2];
+    }
+    else if (c1 == 'F' || c1 == 'f')
+    {
+        if ((uint)c2 >= f_max)
+        {
+            return NULL;
+        }
+
+        entry = &f_table[c2];
+    }
+    else if ((uint)c1 >= cmd_max)
+    {
+        return NULL;
+    }
+    else
+    {
+        entry = &cmd_table[c1];
+    }
+
+    if (entry->scan == NULL && entry->exec == NULL)
+    {
+        return NULL;
+    }
+
+    return entry;
+}
+
+
+///
+///  @brief    Parse text strings following command.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void parse_texts(struct cmd *cmd, int ntexts, int delim)
+{
+    assert(cmd != NULL);
+
+    // If the user specified the at-sign modifier, then skip any whitespace
+    // between the command and the delimiter.
+
+    if (cmd->atsign)                    // @ modifier?
+    {
+        int c;
+
+        while ((c = peek_cbuf()) != TAB && isspace(c))
+        {
+            next_cbuf();                // Skip the whitespace character
+        }
+
+        c = require_cbuf();             // Get text string delimiter
+
+        if (isgraph(c) || (c >= CTRL_A && c <= CTRL_Z))
+        {
+            trace_cbuf(c);
+
+            delim = (char)c;
+        }
+        else
+        {
+            throw(E_TXT, c);            // Invalid text delimiter
+        }
+    }
+
+    // If we are allowing paired text delimiters, then the first delimiter
+    // cannot be a closing parenthesis, bracket, or brace.
+
+    if (strchr(")>]}", delim) != NULL && f.e1.text)
+    {
+        throw(E_TXT, delim);            // Invalid text delimiter
+    }
+
+    if (strchr("(<[{", delim) == NULL || !f.e1.text)
+    {
+        scan_text(delim, &cmd->text1);
+
+        if (ntexts == 2)
+        {
+            scan_text(delim, &cmd->text2);
+        }
+
+        return;
+    }
+
+    // Here if user wants to delimit text string(s) with paired parentheses,
+    // brackets, or braces. This means the text strings may be of the form
+    // (xxx), <xxx>, [xxx], or {xxx}, and may include leading or trailing
+    // whitespace, allowing commands such as @S {foo}, @FS [foo] [baz],
+    // @S<foobaz>, or @^A (foo). Note that if a command allows two text
+    // arguments, the second must be delimited by the same character pair
+    // as the first.
+
+    const char *end = strchr("()<>[]{}", delim);
+
+    assert(end != NULL);
+
+    // Point to closing parenthesis, bracket, or brace
+
+    ++end;
+
+    scan_text(*end, &cmd->text1);
+
+    if (ntexts != 2)
+    {
+        return;
+    }
+
+    // Skip any whitespace after ')', '>', ']', or '}'
+
+    int c;
+
+    while ((c = peek_cbuf()) != TAB && isspace(c))
+    {
+        next_cbuf();                    // Skip the whitespace character
+    }
+
+    c = require_cbuf();                 // Get text string delimiter
+
+    if (c != delim)                     // Must be same delimiter
+    {
+        throw(E_TXT, c);                // Invalid text delimiter
+    }
+
+    trace_cbuf(c);
+
+    scan_text(*end, &cmd->text2);
+}
+
+
 ///
 ///  @brief    Scan for secondary commands (E, F, and ^).
 ///
@@ -286,10 +609,23 @@ static inline const struct cmd_table *scan_cmd(struct cmd *cmd, int c)
 
     const struct cmd_table *entry = &cmd_table[c];
 
-    // Check for secondary commands (E, F, and ^).
+    // Check for secondary commands (E, F, and ^). If we've already decoded
+    // the command at this position of a macro, then use what we found then.
 
-    if (entry->scan == NULL && entry->exec == NULL)
+    struct op *op;
+
+    if (entry->scan == NULL && entry->exec == NULL && !f.trace.enable
+        && (op = find_op(cbuf->pos - 1, false)) != NULL && op->entry != NULL)
+    {
+        cmd->c1   = op->c1;
+        cmd->c2   = op->c2;
+        cbuf->pos = op->next;
+        entry     = op->entry;
+    }
+    else if (entry->scan == NULL && entry->exec == NULL)
     {
+        const uint_t start = cbuf->pos - 1;
+
         // Note that the order of the conditional tests below are based on
         // the anticipated frequency of the respective commands. That is,
         // we anticipate ^ commands more often than E commands, which in
@@ -355,6 +691,14 @@ static inline const struct cmd_table *scan_cmd(struct cmd *cmd, int c)
 
             entry = &f_table[c];
         }
+
+        if ((op = find_op(start, true)) != NULL)
+        {
+            op->entry = entry;
+            op->next  = cbuf->pos;
+            op->c1    = cmd->c1;
+            op->c2    = cmd->c2;
+        }
     }
 
     // If we will execute a command after scanning it, then see if we
@@ -450,7 +794,9 @@ static void scan_text(int delim, tstring *text)
 
 
 ///
-///  @brief    Scan for text strings following command.
+///  @brief    Scan for text strings following command. If we've already scanned
+///            the text at this position of a macro, then use what we found
+///            then (unless something has changed that would affect the scan).
 ///
 ///  @returns  Nothing.
 ///
@@ -460,97 +806,52 @@ void scan_texts(struct cmd *cmd, int ntexts, int delim)
 {
     assert(cmd != NULL);
 
-    // If the user specified the at-sign modifier, then skip any whitespace
-    // between the command and the delimiter.
+    const uint_t start = cbuf->pos;
+    const uint_t line = cmd_line;
+    struct op *op;
 
-    if (cmd->atsign)                    // @ modifier?
+    if (!f.trace.enable && (op = find_op(start, false)) != NULL
+        && op->end != 0 && op->ntexts == ntexts && op->delim == delim
+        && op->atsign == cmd->atsign && op->etext == f.e1.text
+        && op->counting == (cmd_line != 0))
     {
-        int c;
+        cmd->text1.data = cbuf->data + op->text1;
+        cmd->text1.len  = op->len1;
 
-        while ((c = peek_cbuf()) != TAB && isspace(c))
+        if (ntexts == 2)
         {
-            next_cbuf();                // Skip the whitespace character
+            cmd->text2.data = cbuf->data + op->text2;
+            cmd->text2.len  = op->len2;
         }
 
-        c = require_cbuf();             // Get text string delimiter
-
-        if (isgraph(c) || (c >= CTRL_A && c <= CTRL_Z))
-        {
-            trace_cbuf(c);
+        cmd_line += op->lines;
+        cbuf->pos = op->end;
 
-            delim = (char)c;
-        }
-        else
-        {
-            throw(E_TXT, c);            // Invalid text delimiter
-        }
+        return;
     }
 
-    // If we are allowing paired text delimiters, then the first delimiter
-    // cannot be a closing parenthesis, bracket, or brace.
-
-    if (strchr(")>]}", delim) != NULL && f.e1.text)
-    {
-        throw(E_TXT, delim);            // Invalid text delimiter
-    }
+    parse_texts(cmd, ntexts, delim);
 
-    if (strchr("(<[{", delim) == NULL || !f.e1.text)
+    if ((op = find_op(start, true)) != NULL)
     {
-        scan_text(delim, &cmd->text1);
+        op->end      = cbuf->pos;
+        op->lines    = cmd_line - line;
+        op->text1    = (uint_t)(cmd->text1.data - cbuf->data);
+        op->len1     = cmd->text1.len;
+        op->delim    = delim;
+        op->ntexts   = ntexts;
+        op->atsign   = cmd->atsign;
+        op->etext    = f.e1.text;
+        op->counting = (line != 0);
 
         if (ntexts == 2)
         {
-            scan_text(delim, &cmd->text2);
+            op->text2 = (uint_t)(cmd->text2.data - cbuf->data);
+            op->len2  = cmd->text2.len;
         }
-
-        return;
-    }
-
-    // Here if user wants to delimit text string(s) with paired parentheses,
-    // brackets, or braces. This means the text strings may be of the form
-    // (xxx), <xxx>, [xxx], or {xxx}, and may include leading or trailing
-    // whitespace, allowing commands such as @S {foo}, @FS [foo] [baz],
-    // @S<foobaz>, or @^A (foo). Note that if a command allows two text
-    // arguments, the second must be delimited by the same character pair
-    // as the first.
-
-    const char *end = strchr("()<>[]{}", delim);
-
-    assert(end != NULL);
-
-    // Point to closing parenthesis, bracket, or brace
-
-    ++end;
-
-    scan_text(*end, &cmd->text1);
-
-    if (ntexts != 2)
-    {
-        return;
     }
-
-    // Skip any whitespace after ')', '>', ']', or '}'
-
-    int c;
-
-    while ((c = peek_cbuf()) != TAB && isspace(c))
-    {
-        next_cbuf();                    // Skip the whitespace character
-    }
-
-    c = require_cbuf();                 // Get text string delimiter
-
-    if (c != delim)                     // Must be same delimiter
-    {
-        throw(E_TXT, c);                // Invalid text delimiter
-    }
-
-    trace_cbuf(c);
-
-    scan_text(*end, &cmd->text2);
 }
 
-
 ///
 ///  @brief    Scan command string for next command. Since many commands are
 ///            used only to create expressions (such as numeric arguments) for
@@ -27,7 +27,6 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
 
 #include "teco.h"
 #include "ascii.h"
@@ -68,11 +67,9 @@ void exec_ctrl_U(struct cmd *cmd)
     {
         if (cmd->colon)                 // :^Utext`
         {
-            const char *p = cmd->text1.data;
-
-            for (uint_t i = 0; i < cmd->text1.len; ++i)
+            if (cmd->text1.len != 0)
             {
-                append_qchr(cmd->qindex, *p++);
+                append_qtext(cmd->qindex, cmd->text1.data, cmd->text1.len);
             }
         }
         else if (cmd->text1.len == 0)   // ^Uq`
@@ -81,12 +78,8 @@ void exec_ctrl_U(struct cmd *cmd)
         }
         else                            // ^Uqtext`
         {
-            tbuffer text = alloc_tbuf(cmd->text1.len);
-
-            text.len = cmd->text1.len;
-
-            memcpy(text.data, cmd->text1.data, (size_t)cmd->text1.len);
-            store_qtext(cmd->qindex, &text);
+            delete_qtext(cmd->qindex);
+            append_qtext(cmd->qindex, cmd->text1.data, cmd->text1.len);
         }
     }
 }
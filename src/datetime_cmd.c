@@ -40,6 +40,14 @@
 
 #define SECONDS_PER_MINUTE      60      ///< Seconds per minute
 
+#define NSECS_PER_USEC          1000uLL ///< Nanoseconds per microsecond
+
+#define USECS_PER_SEC           1000000uLL ///< Microseconds per second
+
+// Local functions
+
+static int_t get_clock(clockid_t clock);
+
 
 ///
 ///  @brief    Scan "^B" (CTRL/B): return current date encoded as follows:
@@ -70,10 +78,37 @@ bool scan_ctrl_B(struct cmd *cmd)
 }
 
 
+///
+///  @brief    Read clock in microseconds. If int_t is only 32 bits, then we
+///            return the low-order 32 bits of the result, so the difference
+///            between two readings is still correct as long as they are less
+///            than 2^31 microseconds (about 35 minutes) apart.
+///
+///  @returns  No. of microseconds.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int_t get_clock(clockid_t clock)
+{
+    struct timespec ts = { .tv_sec = 0 };
+
+    (void)clock_gettime(clock, &ts);
+
+    unsigned long long usec = (unsigned long long)ts.tv_sec * USECS_PER_SEC
+                            + (unsigned long long)ts.tv_nsec / NSECS_PER_USEC;
+
+    return (int_t)(uint_t)usec;
+}
+
+
 ///
 ///  @brief    Scan "^H" (CTRL/H): return current time as milliseconds since
 ///            midnight.
 ///
+///            :^H returns a monotonic timestamp in microseconds, and ::^H
+///            returns the CPU time used by TECO in microseconds. These are
+///            intended for timing sections of macros.
+///
 ///  @returns  true if command is an operand or operator, else false.
 ///
 ////////////////////////////////////////////////////////////////////////////////
@@ -82,9 +117,20 @@ bool scan_ctrl_H(struct cmd *cmd)
 {
     assert(cmd != NULL);
 
-    reject_colon(cmd->colon);
     reject_atsign(cmd->atsign);
 
+    if (cmd->colon)
+    {
+        clockid_t clock = cmd->dcolon ? CLOCK_PROCESS_CPUTIME_ID
+                                      : CLOCK_MONOTONIC;
+
+        push_x(get_clock(clock), X_OPERAND);
+
+        cmd->colon = cmd->dcolon = false;
+
+        return true;
+    }
+
     time_t t = time(NULL);
     struct tm tm;
     struct timeval tv = { .tv_usec = 0 };
@@ -36,6 +36,7 @@
 #include "estack.h"
 #include "file.h"
 #include "qreg.h"
+#include "stats.h"
 
 
 ///
@@ -78,6 +79,8 @@ void exec_E_pct(struct cmd *cmd)
                 {
                     throw(E_ERR, ofile->name); // General error
                 }
+
+                stats[STAT_WRITE + ostream] += size;
             }
 
             close_output(ostream);
@@ -0,0 +1,537 @@
+///
+///  @file    each_sys.c
+///  @brief   Execute TECO macro on each of a list of files.
+///
+///  @copyright 2019-2021 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "teco.h"
+#include "ascii.h"
+#include "cbuf.h"
+#include "each.h"
+#include "editbuf.h"
+#include "eflags.h"
+#include "errcodes.h"
+#include "estack.h"
+#include "exec.h"
+#include "file.h"
+#include "flow.h"
+#include "page.h"
+
+
+//  The --each option executes the --execute macro on each of a list of files,
+//  using one or more worker processes. The list is either a wildcard file
+//  specification, which is expanded with set_wild() and get_wild() in the
+//  same way as for the EN command, or the name of a file containing a list of
+//  file names (one per line) preceded by an at-sign.
+//
+//  After any initialization file has been executed, TECO forks the requested
+//  number of workers, and each worker then processes every nth file in the
+//  list. For each file, a worker executes the equivalent of the following
+//  command string:
+//
+//      EBfile` Y m,nEImacro` EC
+//
+//  Since the macro is loaded (and its flow tables cached) before the workers
+//  are created, it is only read and scanned once. If the command string
+//  completes, or if the macro executes an EX command (which then closes the
+//  file instead of exiting), the file is updated. If an error occurs, the
+//  output file is deleted and the original file is left as it was. Either
+//  way, the edit buffer, any pages of output, open files, and local
+//  Q-registers are reset before the next file is started, but global
+//  Q-registers and flags are kept. EG commands are not allowed, since they
+//  would end the worker.
+//
+//  Each worker sends the result for each file through a pipe, and when all of
+//  the workers have exited, TECO prints a summary with the status of each
+//  file, then exits with a failure status if any file could not be processed.
+
+
+///  @struct  result
+///  @brief   Result of processing one file (written atomically to pipe).
+
+struct result
+{
+    uint index;                     ///< Index in file list
+    int error;                      ///< Error code, or E_NUL if success
+    char message[ERR_MSG_SIZE];     ///< Error message
+};
+
+static const char *each_files;      ///< Wildcard or @-file for files
+
+static const char *each_macro;      ///< Macro to execute on each file
+
+static const char *each_args;       ///< m,n arguments for macro
+
+static uint each_jobs;              ///< No. of worker processes
+
+static char **file_list;            ///< List of file names
+
+static uint nfiles;                 ///< No. of file names in list
+
+static uint maxfiles;               ///< Allocated size of file list
+
+
+// Local functions
+
+static void add_file(const char *name);
+
+static void exec_file(const char *name, struct result *result);
+
+static void free_files(void);
+
+static void get_files(void);
+
+static void reset_file(void);
+
+static noreturn void run_worker(uint worker, uint njobs, int fd);
+
+
+///
+///  @brief    Add file name to list.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void add_file(const char *name)
+{
+    assert(name != NULL);
+
+    if (nfiles == maxfiles)
+    {
+        uint_t size = (uint_t)(maxfiles * sizeof(char *));
+        uint_t delta = (uint_t)(KB * sizeof(char *));
+
+        if (file_list == NULL)
+        {
+            file_list = alloc_mem(delta);
+        }
+        else
+        {
+            file_list = expand_mem(file_list, size, delta);
+        }
+
+        maxfiles += KB;
+    }
+
+    file_list[nfiles] = alloc_mem((uint_t)strlen(name) + 1);
+
+    strcpy(file_list[nfiles++], name);
+}
+
+
+///
+///  @brief    Execute --each option: run macro on each file in list, using
+///            one or more worker processes, and print a summary of the
+///            results. This function returns only if there is no --each
+///            option.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void exec_each(void)
+{
+    if (each_files == NULL)
+    {
+        return;
+    }
+
+    f.et.abort = true;                  // Errors here are fatal
+
+    get_files();
+
+    if (nfiles == 0)
+    {
+        tprint("No files match '%s'\n", each_files);
+
+        exit(EXIT_FAILURE);
+    }
+
+    // Load the macro now, so that workers inherit its text and flow tables.
+
+    const char *name = init_filename(each_macro, (uint_t)strlen(each_macro),
+                                     (bool)false);
+    tbuffer macro;
+
+    if (name != NULL && open_macro(name, IFILE_INDIRECT, (bool)false, &macro)
+        && macro.data != NULL)
+    {
+        char file[strlen(last_file) + 1];
+
+        strcpy(file, last_file);
+        close_flow(&macro, file);
+    }
+
+    uint njobs = (each_jobs < nfiles) ? each_jobs : nfiles;
+    pid_t pids[njobs];
+    int fd[2];
+
+    if (pipe(fd) != 0)
+    {
+        throw(E_ERR, "pipe");           // General error
+    }
+
+    fflush(stdout);                     // Don't duplicate buffered output
+    flush_log();
+
+    for (uint i = 0; i < njobs; ++i)
+    {
+        if ((pids[i] = fork()) == -1)
+        {
+            throw(E_ERR, "fork");       // General error
+        }
+        else if (pids[i] == 0)
+        {
+            close(fd[0]);
+            run_worker(i, njobs, fd[1]);
+        }
+    }
+
+    close(fd[1]);
+
+    // Collect results until all workers have closed the pipe. Each result is
+    // written with a single write(), which is atomic for a pipe, so a read()
+    // of the same size always returns exactly one result.
+
+    struct result *results = alloc_mem((uint_t)(nfiles * sizeof(*results)));
+    struct result result;
+    ssize_t nbytes;
+
+    for (uint i = 0; i < nfiles; ++i)
+    {
+        results[i].error = -1;          // Not processed yet
+    }
+
+    while ((nbytes = read(fd[0], &result, sizeof(result))) != 0)
+    {
+        if (nbytes == (ssize_t)sizeof(result) && result.index < nfiles)
+        {
+            results[result.index] = result;
+        }
+        else if (nbytes == -1 && errno != EINTR)
+        {
+            break;
+        }
+    }
+
+    close(fd[0]);
+
+    // Wait for workers, and report any files they were unable to process.
+
+    uint nfailed = 0;
+
+    for (uint i = 0; i < njobs; ++i)
+    {
+        int status;
+
+        while (waitpid(pids[i], &status, 0) == -1 && errno == EINTR)
+        {
+            ;
+        }
+
+        for (uint j = i; j < nfiles; j += njobs)
+        {
+            if (results[j].error != -1)
+            {
+                continue;
+            }
+
+            if (WIFSIGNALED(status))
+            {
+                snprintf(results[j].message, sizeof(results[j].message),
+                         "Not processed (worker killed by signal %d)",
+                         WTERMSIG(status));
+            }
+            else
+            {
+                snprintf(results[j].message, sizeof(results[j].message),
+                         "Not processed (worker exited with status %d)",
+                         WEXITSTATUS(status));
+            }
+        }
+    }
+
+    for (uint i = 0; i < nfiles; ++i)
+    {
+        if (results[i].error == E_NUL)
+        {
+            tprint("%s: OK\n", file_list[i]);
+        }
+        else
+        {
+            tprint("%s: %s\n", file_list[i], results[i].message);
+
+            ++nfailed;
+        }
+    }
+
+    tprint("%u file%s processed by %u job%s: %u succeeded, %u failed\n",
+           nfiles, nfiles == 1 ? "" : "s", njobs, njobs == 1 ? "" : "s",
+           nfiles - nfailed, nfailed);
+
+    free_mem(&results);
+    free_files();
+
+    exit(nfailed == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+///
+///  @brief    Open file, execute macro, and close file. If an error occurs,
+///            the error code and message are saved in the result.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void exec_file(const char *name, struct result *result)
+{
+    assert(name != NULL);
+    assert(result != NULL);
+
+    switch (setjmp(jump_main))
+    {
+        case MAIN_NORMAL:
+        {
+            char cmd[PATH_MAX * 2 + 100];
+            struct cmd newcmd = null_cmd;
+
+            snprintf(cmd, sizeof(cmd), "EB%s\e Y %sEI%s\e EC ", name,
+                     each_args ?: "", each_macro);
+
+            reset_cbuf();
+
+            for (const char *p = cmd; *p != NUL; ++p)
+            {
+                store_cbuf(*p);
+            }
+
+            init_x();                   // Initialize expression stack
+
+            f.e0.exec = true;           // Command is in progress
+
+            exec_cmd(&newcmd);          // Execute command string
+
+            break;
+        }
+
+        case MAIN_EXIT:                 // EX closed file, so we're done
+            break;
+
+        default:                        // Error or CTRL/C
+            result->error = (last_error != E_NUL) ? last_error : E_XAB;
+
+            strcpy(result->message, last_message);
+
+            break;
+    }
+
+    reset_file();
+}
+
+
+///
+///  @brief    Free file list.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void free_files(void)
+{
+    for (uint i = 0; i < nfiles; ++i)
+    {
+        free_mem(&file_list[i]);
+    }
+
+    free_mem(&file_list);
+
+    nfiles = maxfiles = 0;
+}
+
+
+///
+///  @brief    Get list of files, either by expanding a wildcard specification
+///            or by reading a file containing a list of file names.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void get_files(void)
+{
+    if (each_files[0] != '@')
+    {
+        if (set_wild(each_files))
+        {
+            while (get_wild() == EXIT_SUCCESS)
+            {
+                add_file(last_file);
+            }
+        }
+
+        return;
+    }
+
+    const char *list = each_files + 1;
+    FILE *fp = fopen(list, "r");
+    char line[PATH_MAX];
+
+    if (fp == NULL)
+    {
+        throw(E_ERR, list);             // General error
+    }
+
+    while (fgets(line, (int)sizeof(line), fp) != NULL)
+    {
+        size_t len = strcspn(line, "\r\n");
+
+        if (len != 0)
+        {
+            line[len] = NUL;
+
+            add_file(line);
+        }
+    }
+
+    fclose(fp);
+}
+
+
+///
+///  @brief    Reset editor state after processing file. If the file is still
+///            open for output, then an error occurred, and we delete the
+///            output file just as the EK command would, so that the original
+///            file is not changed.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void reset_file(void)
+{
+    for (uint stream = OFILE_PRIMARY; stream <= OFILE_SECONDARY; ++stream)
+    {
+        struct ofile *ofile = &ofiles[stream];
+
+        reset_pages(stream);
+
+        if (ofile->fp != NULL)
+        {
+            fclose(ofile->fp);
+
+            ofile->fp = NULL;
+
+            (void)remove(ofile->temp ?: ofile->name);
+        }
+
+        close_output(stream);
+    }
+
+    close_input(IFILE_PRIMARY);
+    close_input(IFILE_SECONDARY);
+
+    istream = IFILE_PRIMARY;
+    ostream = OFILE_PRIMARY;
+
+    kill_ebuf();                        // Empty edit buffer
+    reset_teco();                       // Reset stacks and local Q-registers
+
+    f.e0.exec  = false;
+    f.e0.error = false;
+    last_error = E_NUL;
+}
+
+
+///
+///  @brief    Process files assigned to worker, and send results to parent.
+///
+///  @returns  Nothing (worker process exits).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static noreturn void run_worker(uint worker, uint njobs, int fd)
+{
+    int status = EXIT_SUCCESS;
+
+    f.et.abort = false;                 // Return to us on error
+    f.e0.each = true;                   // Summary reports errors, not worker
+
+    for (uint i = worker; i < nfiles; i += njobs)
+    {
+        struct result result = { .index = i, .error = E_NUL };
+
+        exec_file(file_list[i], &result);
+
+        if (result.error != E_NUL)
+        {
+            status = EXIT_FAILURE;
+        }
+
+        while (write(fd, &result, sizeof(result)) == -1 && errno == EINTR)
+        {
+            ;
+        }
+    }
+
+    close(fd);
+    free_files();
+
+    // Skip the exit handlers: the parent writes any profile and statistics,
+    // and checks memory, once for all of the workers.
+
+    fflush(stdout);
+    flush_log();
+
+    _exit(status);
+}
+
+
+///
+///  @brief    Set up for --each option.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void set_each(const char *files, const char *macro, const char *args,
+              uint jobs)
+{
+    assert(files != NULL);
+    assert(macro != NULL);
+
+    each_files = files;
+    each_macro = macro;
+    each_args  = args;
+    each_jobs  = (jobs != 0) ? jobs : 1;
+}
@@ -73,6 +73,11 @@ void exec_EG(struct cmd *cmd)
         return;
     }
 
+    if (f.e0.each)                      // Can't exit from --each worker
+    {
+        throw(E_IEC, cmd->c2);          // Invalid character after E
+    }
+
     tstring eg = build_string(cmd->text1.data, cmd->text1.len);
 
     snprintf(eg_command, sizeof(eg_command), "%s", eg.data);
@@ -34,6 +34,7 @@
 #include "estack.h"
 #include "exec.h"
 #include "file.h"
+#include "flow.h"
 
 
 ///  @var    ei_old
@@ -121,7 +122,7 @@ void exec_EI(struct cmd *cmd)
         {
             tbuffer ei_new;
 
-            if (open_command(name, stream, cmd->colon, &ei_new))
+            if (open_macro(name, stream, cmd->colon, &ei_new))
             {
                 if (cmd->colon)
                 {
@@ -130,11 +131,15 @@ void exec_EI(struct cmd *cmd)
 
                 if (ei_new.size != 0)
                 {
+                    char file[strlen(last_file) + 1];
+
+                    strcpy(file, last_file);
+
                     ++ei_depth;
 
                     exec_macro(&ei_new, cmd);
 
-                    free_mem(&ei_new.data);
+                    close_flow(&ei_new, file);
 
                     --ei_depth;
                 }
@@ -209,6 +214,8 @@ void reset_indirect(void)
     free_mem(&ei_old.data);
 
     ei_depth = 0;
+
+    release_flow();                     // No EI commands are now active
 }
 
 
@@ -88,6 +88,8 @@ void exit_EG(void)
 {
     if (eg_command[0] != NUL)
     {
+        (void)fflush(stdout);           // Don't lose any buffered output
+
         if (execlp("/bin/sh", "sh", "-c", eg_command, NULL) == -1)
         {
             perror("EG command failed");
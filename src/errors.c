@@ -37,6 +37,8 @@
 #include "eflags.h"
 #include "errcodes.h"
 #include "exec.h"
+#include "file.h"
+#include "ring.h"
 #include "term.h"
 
 #include "cbuf.h"
@@ -49,16 +51,43 @@
 
 int last_error = E_NUL;             ///< Last error encountered
 
+char last_message[ERR_MSG_SIZE];    ///< Text of last error message
+
 static char *last_command;          ///< Command string for last error
 
 
 // Local functions
 
+static void add_message(const char *format, ...);
+
 static void convert(char *buf, uint bufsize, const char *err_str, uint len);
 
 static void print_error(int error, const char *err_str, const char *file_str);
 
 
+///
+///  @brief    Add text to last error message.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void add_message(const char *format, ...)
+{
+    assert(format != NULL);
+
+    size_t len = strlen(last_message);
+    va_list args;
+
+    va_start(args, format);
+
+    (void)vsnprintf(last_message + len, sizeof(last_message) - len, format,
+                    args);
+
+    va_end(args);
+}
+
+
 ///
 ///  @brief    Convert string to canonical format by making control characters
 ///            visible.
@@ -202,18 +231,19 @@ static void print_error(int error, const char *err_str, const char *file_str)
     const char *code = errlist[error].code;
     const char *text = errlist[error].text;
 
-    tprint("?%s", code);                // Always print code
-
     last_error = error;
+    last_message[0] = NUL;
+
+    add_message("?%s", code);           // Always print code
 
     if (f.eh.verbose != 1)              // Need to print more?
     {
-        tprint("   ");
-        tprint(text, err_str ?: "");
+        add_message("   ");
+        add_message(text, err_str ?: "");
 
         if (error == E_ERR && file_str != NULL)
         {
-            tprint(" for '%s'", file_str);
+            add_message(" for '%s'", file_str);
         }
     }
 
@@ -229,11 +259,17 @@ static void print_error(int error, const char *err_str, const char *file_str)
 
         if (macro || cmd_line > 1)
         {
-            tprint(" in %s at line %lu", macro ? "macro" : "command",
-                   (ulong)cmd_line);
+            add_message(" in %s at line %lu", macro ? "macro" : "command",
+                        (ulong)cmd_line);
         }
     }
 
+    if (f.e0.each)                      // Save message for --each summary?
+    {
+        return;
+    }
+
+    tprint("%s", last_message);
     type_out(CR);
     type_out(LF);
 
@@ -411,6 +447,18 @@ noreturn void throw(int error, ...)
         print_error(error, err_str, file_str);
     }
 
+    if (f.e3.ring)                      // Recording commands?
+    {
+        dump_ring();                    // Yes, dump commands leading to error
+    }
+
+    flush_log();                        // Make sure log file is complete
+
+    if (f.e0.batch)
+    {
+        (void)fflush(stdout);           // Write error message now
+    }
+
     if (f.et.abort)                     // Abort on error?
     {
         exit(EXIT_FAILURE);
@@ -59,5 +59,10 @@ void exec_EX(struct cmd *unused)
     reset_if();
     reset_loop();
 
+    if (f.e0.each)                      // Processing file for --each?
+    {
+        longjmp(jump_main, MAIN_EXIT);  // Yes, go on to next file
+    }
+
     exit(EXIT_SUCCESS);
 }
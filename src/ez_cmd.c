@@ -39,7 +39,7 @@
 #include "file.h"
 
 
-#define EZ_SIZE         (KB * 4)        ///< Allocate memory in 4 KB chunks
+#define EZ_SIZE         (KB * 4)        ///< Initial allocation size
 
 tstring ez = { .data = NULL, .len = 0 }; ///< Output from EZ command
 
@@ -92,15 +92,18 @@ void exec_EZ(struct cmd *cmd)
 
     uint_t pos = 0;
 
-    while ((size = fread(ez.data + pos, 1uL, (size_t)EZ_SIZE, fp)) > 0)
+    // Read as much as will fit in what's left of the buffer, and double its
+    // size whenever it fills up.
+
+    while ((size = fread(ez.data + pos, 1uL, (size_t)(ez.len - pos), fp)) > 0)
     {
-        if (size + pos == ez.len)
+        pos += (uint_t)size;
+
+        if (pos == ez.len)
         {
-            ez.data = expand_mem(ez.data, ez.len, EZ_SIZE);
-            ez.len += EZ_SIZE;
+            ez.data = expand_mem(ez.data, ez.len, ez.len);
+            ez.len *= 2;
         }
-
-        pos += (uint_t)size;
     }
 
     if (ferror(fp) || pclose(fp) == -1)
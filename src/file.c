@@ -41,10 +41,14 @@
 #include "eflags.h"
 #include "errcodes.h"
 #include "file.h"
+#include "flow.h"
 #include "page.h"
+#include "stats.h"
 #include "term.h"
 
 
+#define LOG_BUFSIZ      (64 * KB)       ///< Buffer size for log file
+
 struct ifile ifiles[IFILE_MAX];         ///< Input file descriptors
 
 struct ofile ofiles[OFILE_MAX];         ///< Output file descriptors
@@ -59,6 +63,9 @@ char last_file[PATH_MAX] = { NUL };     ///< Last opened file
 
 static char *make_canonical(const char *name);
 
+static bool read_command(const char *name, uint stream, bool colon,
+                         tbuffer *text, bool compiled);
+
 
 ///
 ///  @brief    Close input file.
@@ -147,6 +154,24 @@ void exit_files(void)
 }
 
 
+///
+///  @brief    Write any buffered output to log file.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void flush_log(void)
+{
+    FILE *fp = ofiles[OFILE_LOG].fp;
+
+    if (fp != NULL)
+    {
+        (void)fflush(fp);
+    }
+}
+
+
 ///
 ///  @brief    Create a file name specification in file name buffer. We copy
 ///            from the specified text string, skipping any characters such as
@@ -291,52 +316,7 @@ static char *make_canonical(const char *name)
 
 bool open_command(const char *name, uint stream, bool colon, tbuffer *text)
 {
-    assert(name != NULL);               // Error if no input file name
-    assert(text != NULL);               // Error if no edit buffer
-
-    struct ifile *ifile = find_command(name, stream, colon);
-
-    // If there was no colon, then we've already thrown an exception.
-    // Therefore, if ifile is NULL, a colon must have been present.
-
-    if (ifile == NULL)
-    {
-        return false;
-    }
-
-    struct stat file_stat;
-
-    if (stat(last_file, &file_stat) != 0)
-    {
-        close_input(stream);
-
-        throw(E_ERR, last_file);        // General error
-    }
-
-    size_t size = (size_t)file_stat.st_size;
-
-    // If there's data in the file, then allocate a buffer for it.
-
-    if ((text->len = text->size = (uint_t)size) != 0)
-    {
-        char tempbuf[size];
-
-        if (fread(tempbuf, 1uL, size, ifile->fp) != size)
-        {
-            close_input(stream);
-
-            throw(E_ERR, ifile->name);  // General error
-        }
-
-        text->pos  = 0;
-        text->data = alloc_mem((uint_t)size);
-
-        memcpy(text->data, tempbuf, size);
-    }
-
-    close_input(stream);
-
-    return true;
+    return read_command(name, stream, colon, text, (bool)false);
 }
 
 
@@ -415,6 +395,24 @@ struct ifile *open_input(const char *name, uint stream, bool colon)
 }
 
 
+///
+///  @brief    Open command file for EI command. This is the same as
+///            open_command(), except that we reuse the text from a previous
+///            EI command, or use a compiled version of the file, if either is
+///            available, and we enable caching of skips, tags, and ops for
+///            the command file. The caller must use close_flow() after the
+///            file is executed, and must not modify the text.
+///
+///  @returns  true if file opened, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool open_macro(const char *name, uint stream, bool colon, tbuffer *text)
+{
+    return read_command(name, stream, colon, text, (bool)true);
+}
+
+
 ///
 ///  @brief    Open file for output. We are called to handle opens for EB, EL,
 ///            EW, and E% commands.
@@ -500,15 +498,88 @@ struct ofile *open_output(const char *name, uint stream, bool colon, int c)
     }
     else if (c == 'L')
     {
-        // Write log output immediately and do not buffer.
+        // Log output is buffered, so that each character typed out or echoed
+        // doesn't need its own write. To ensure that the log is complete when
+        // anything goes wrong, the buffer is flushed whenever we wait for
+        // input, whenever an error occurs, and if we abort or crash.
 
-        (void)setvbuf(ofile->fp, NULL, _IONBF, 0uL);
+        (void)setvbuf(ofile->fp, NULL, _IOFBF, (size_t)LOG_BUFSIZ);
     }
 
     return ofile;
 }
 
 
+///
+///  @brief    Read command file for open_command() or open_macro().
+///
+///  @returns  true if file opened, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool read_command(const char *name, uint stream, bool colon,
+                         tbuffer *text, bool compiled)
+{
+    assert(name != NULL);               // Error if no input file name
+    assert(text != NULL);               // Error if no edit buffer
+
+    struct ifile *ifile = find_command(name, stream, colon);
+
+    // If there was no colon, then we've already thrown an exception.
+    // Therefore, if ifile is NULL, a colon must have been present.
+
+    if (ifile == NULL)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+
+    if (stat(last_file, &file_stat) != 0)
+    {
+        close_input(stream);
+
+        throw(E_ERR, last_file);        // General error
+    }
+
+    if (compiled && load_flow(text, last_file, &file_stat))
+    {
+        close_input(stream);
+
+        return true;
+    }
+
+    size_t size = (size_t)file_stat.st_size;
+
+    // If there's data in the file, then allocate a buffer for it.
+
+    if ((text->len = text->size = (uint_t)size) != 0)
+    {
+        text->pos  = 0;
+        text->data = alloc_mem((uint_t)size);
+
+        if (fread(text->data, 1uL, size, ifile->fp) != size)
+        {
+            free_mem(&text->data);
+            close_input(stream);
+
+            throw(E_ERR, ifile->name);  // General error
+        }
+
+        stats[STAT_READ + stream] += size;
+
+        if (compiled)
+        {
+            keep_flow(text, last_file, &file_stat);
+        }
+    }
+
+    close_input(stream);
+
+    return true;
+}
+
+
 ///
 ///  @brief    Save name of last file opened.
 ///
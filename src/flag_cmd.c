@@ -38,6 +38,9 @@
 #include "estack.h"
 #include "exec.h"
 #include "file.h"
+#include "profile.h"
+#include "ring.h"
+#include "stats.h"
 
 #if     defined(DISPLAY_MODE)
 
@@ -212,7 +215,19 @@ void exec_E2(struct cmd *cmd)
 
 void exec_E3(struct cmd *cmd)
 {
+    union e3_flag saved = { .flag = f.e3.flag };
+
     check_mn_flag(cmd, &f.e3.flag);
+
+    if (saved.profile && !f.e3.profile) // Did we just stop profiling?
+    {
+        write_prof();                   // Yes, write what we have so far
+    }
+
+    if (saved.ring && !f.e3.ring)       // Did we just stop recording?
+    {
+        dump_ring();                    // Yes, dump what we have so far
+    }
 }
 
 
@@ -415,7 +430,6 @@ bool scan_EJ(struct cmd *cmd)
     assert(cmd != NULL);
 
     require_n(cmd->m_set, cmd->n_set);
-    reject_dcolon(cmd->dcolon);
     reject_atsign(cmd->atsign);
 
     int n = 0;                          // 0EJ is default command
@@ -425,6 +439,15 @@ bool scan_EJ(struct cmd *cmd)
         n = (int)cmd->n_arg;            // Get whatever operand we can
     }
 
+    if (cmd->dcolon)                    // n::EJ reads performance counter
+    {
+        push_x((int_t)get_stat(n), X_OPERAND);
+
+        cmd->colon = cmd->dcolon = false;
+
+        return true;
+    }
+
     n = teco_env(n, cmd->colon);        // Do the system-dependent part
 
     push_x((int_t)n, X_OPERAND);        // Now return the result
@@ -0,0 +1,1394 @@
+///
+///  @file    flow.c
+///  @brief   Cache of flow targets for loops and conditionals.
+///
+///  @copyright 2019-2021 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "teco.h"
+#include "ascii.h"
+#include "cbuf.h"
+#include "eflags.h"
+#include "exec.h"
+#include "flow.h"
+
+
+//  Loops and conditionals are exited by skipping forward through the command
+//  string to the matching > or ' (or |), which means re-scanning the same text
+//  each time a loop ends or a test fails. For macros stored in Q-registers, we
+//  keep a table for each command string that maps the position of each flow
+//  command to the position of its target, along with the net changes in state
+//  that the skip made, so that later skips from the same place are immediate.
+//
+//  A table depends only on the text of the command string, so it is discarded
+//  whenever the Q-register text is changed or deallocated. Since the scanning
+//  of a command string depends on the E1 and E2 flags and on the parenthesis
+//  count, those are saved with each entry and must match for it to be used.
+//
+//  Similarly, O commands scan the entire command string to find a tag and to
+//  verify that it is unique and in a valid location. The first complete scan
+//  records every tag in a hash table, and later O commands use that instead.
+//
+//  Finally, we record the result of decoding multi-character commands (such as
+//  E and F commands) and of scanning text operands, indexed by position, so
+//  that executing a command string a second time does not need to re-scan its
+//  text. Whether the text was scanned with the @ modifier, with paired text
+//  delimiters, or while counting lines is saved so that we can check it.
+//
+//  The tables for an EI command file can also be saved in a compiled file
+//  which has the same name as the command file with a "c" appended (e.g.,
+//  squish.tec and squish.tecc). This is done after the file is executed if
+//  the E3&512 bit is set. The compiled file contains a header, the text of
+//  the command file, and then the entries for skips, tags, and ops. If it
+//  exists, and the size and modification time of the command file match
+//  those in the header, then EI maps the compiled file into memory instead
+//  of reading the command file, and starts with the saved tables.
+//
+//  The text and tables for an EI command file are also kept after the file
+//  has been executed, so that a subsequent EI command for the same file can
+//  reuse them if the file has not been changed (as determined by its device,
+//  inode, size, and modification time). If the same file is executed while
+//  it is already active, both commands share the same (read-only) text.
+
+#define MAX_FLOW    8               ///< No. of command strings cached
+
+#define FLOW_SIZE   16              ///< Initial no. of entries per table
+
+#define TAG_SIZE    16              ///< Initial no. of entries for tags
+
+#define OP_SIZE     32              ///< No. of ops to allocate at a time
+
+#define FLOW_MAGIC  "TECO-64"       ///< Signature for compiled files
+
+#define FLOW_VERSION 1              ///< Version of compiled file format
+
+#define FLOW_TYPE   "c"             ///< Suffix for compiled file names
+
+///  @def    align_flow
+///  @brief  Offset of entries in compiled file with text of specified length.
+
+#define align_flow(len) ((sizeof(struct header) + (len) + 7) & ~(size_t)7)
+
+///  @struct  jump
+///  @brief   Cached skip for a flow command.
+
+struct jump
+{
+    uint_t start;                   ///< Starting position (0 if unused)
+    uint_t end;                     ///< Ending position
+    uint_t lines;                   ///< No. of lines skipped
+    int_t e1;                       ///< E1 flag when skip was done
+    int_t e2;                       ///< E2 flag when skip was done
+    uint nparens;                   ///< Starting parenthesis count
+    int parens;                     ///< Net change in parenthesis count
+    int loops;                      ///< Net change in loop depth
+    int ifs;                        ///< Net change in conditional depth
+    enum flow_type type;            ///< Type of skip
+    bool counting;                  ///< true if counting lines
+};
+
+///  @struct  table
+///  @brief   Cached skips for a command string.
+
+struct table
+{
+    const char *data;               ///< Command string text
+    uint_t len;                     ///< Length of command string
+    uint size;                      ///< No. of entries (power of two)
+    uint count;                     ///< No. of entries in use
+    struct jump *jump;              ///< Hash table of cached skips
+    uint tag_size;                  ///< No. of tag entries (power of two)
+    uint ntags;                     ///< No. of tag entries in use
+    struct tag *tag;                ///< Hash table of tags
+    bool tags_ok;                   ///< true if tag table is complete
+    int_t tag_e1;                   ///< E1 flag when tags were scanned
+    int_t tag_e2;                   ///< E2 flag when tags were scanned
+    uint nparens;                   ///< Starting parenthesis count for scan
+    int parens;                     ///< Net change in parenthesis count
+    uint_t loop_end;                ///< Position after first > command
+    uint *index;                    ///< Op for each position (0 if none)
+    uint nops;                      ///< No. of ops in use
+    uint maxops;                    ///< No. of ops allocated
+    struct op *op;                  ///< Pre-scanned commands and operands
+    bool saved;                     ///< true if compiled file is up to date
+    char *map;                      ///< Mapped compiled file (or NULL)
+    size_t map_size;                ///< Size of mapped compiled file
+    char *file;                     ///< EI command file (NULL if Q-register)
+    dev_t dev;                      ///< Device for command file
+    ino_t ino;                      ///< Inode for command file
+    long mtime;                     ///< Modification time of command file
+    long mtime_ns;                  ///< Nanoseconds for modification time
+    uint busy;                      ///< No. of active EI commands for file
+};
+
+///  @struct  header
+///  @brief   Header for compiled command file.
+
+struct header
+{
+    char magic[8];                  ///< File signature
+    uint version;                   ///< Format version
+    uint sizes[4];                  ///< Sizes of header and entries
+    uint checksum;                  ///< FNV-1a hash of command text
+    uint_t len;                     ///< Length of command text
+    long mtime;                     ///< Modification time of command file
+    long mtime_ns;                  ///< Nanoseconds for modification time
+    uint njumps;                    ///< No. of skips
+    uint ntags;                     ///< No. of tags
+    uint nops;                      ///< No. of ops
+    bool tags_ok;                   ///< true if tag table is complete
+    int_t tag_e1;                   ///< E1 flag when tags were scanned
+    int_t tag_e2;                   ///< E2 flag when tags were scanned
+    uint nparens;                   ///< Starting parenthesis count for scan
+    int parens;                     ///< Net change in parenthesis count
+    uint_t loop_end;                ///< Position after first > command
+};
+
+///  @struct  tag_entry
+///  @brief   Tag saved in compiled file.
+
+struct tag_entry
+{
+    uint_t text;                    ///< Offset of tag text
+    struct tag tag;                 ///< Tag (w/o pointer to text)
+};
+
+///  @struct  op_entry
+///  @brief   Op saved in compiled file.
+
+struct op_entry
+{
+    uint_t pos;                     ///< Position of op
+    bool decoded;                   ///< true if op has command table entry
+    struct op op;                   ///< Op (w/o command table entry)
+};
+
+static struct table table[MAX_FLOW]; ///< Tables for cached command strings
+
+static uint next_table = 0;         ///< Next table to reuse
+
+static uint last_table = 0;         ///< Last table found
+
+// Local functions
+
+static uint checksum(const char *data, uint_t len);
+
+static struct jump *find_jump(struct table *t, uint_t pos,
+                              enum flow_type type);
+
+static struct table *find_table(void);
+
+static struct tag *find_tag(struct table *t, const char *text, uint_t len);
+
+static void free_table(struct table *t);
+
+static bool load_table(struct table *t, const struct header *header);
+
+static bool match_file(const struct table *t, const char *file,
+                       const struct stat *source);
+
+static struct table *new_table(const char *data, uint_t len, uint size);
+
+static void save_flow(const struct table *t, const char *file);
+
+static void set_file(struct table *t, const char *file,
+                     const struct stat *source);
+
+static void set_sizes(uint sizes[4]);
+
+
+///
+///  @brief    Add tag found while scanning command string for O command. If
+///            the tag was previously found, we just flag it as a duplicate.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void add_tag(const struct tag *tag)
+{
+    assert(tag != NULL);
+
+    struct table *t = find_table();
+
+    if (t == NULL || t->tag == NULL)
+    {
+        return;
+    }
+
+    // Keep the table no more than 3/4 full, so that probes are short.
+
+    if ((t->ntags + 1) * 4 > t->tag_size * 3)
+    {
+        struct tag *old = t->tag;
+        uint size = t->tag_size;
+
+        t->tag_size *= 2;
+        t->tag = alloc_mem((uint_t)(sizeof(*t->tag) * t->tag_size));
+
+        for (uint i = 0; i < size; ++i)
+        {
+            if (old[i].text != NULL)
+            {
+                *find_tag(t, old[i].text, old[i].len) = old[i];
+            }
+        }
+
+        free_mem(&old);
+    }
+
+    struct tag *entry = find_tag(t, tag->text, tag->len);
+
+    if (entry->text != NULL)
+    {
+        entry->dup = true;
+    }
+    else
+    {
+        *entry = *tag;
+
+        entry->dup = false;
+
+        ++t->ntags;
+    }
+}
+
+
+///
+///  @brief    Calculate FNV-1a hash of command text.
+///
+///  @returns  Hash value.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint checksum(const char *data, uint_t len)
+{
+    assert(data != NULL);
+
+    uint hash = 2166136261u;
+
+    for (uint_t i = 0; i < len; ++i)
+    {
+        hash = (hash ^ (uchar)data[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+
+///
+///  @brief    Finish execution of EI command file. If the E3&512 bit is set,
+///            and the tables for the file have changed, then save them in a
+///            compiled file. The text and tables are kept for use by later EI
+///            commands; they are deallocated (or unmapped) only when they are
+///            reused for another command string, or when we exit.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void close_flow(tbuffer *macro, const char *file)
+{
+    assert(macro != NULL);
+    assert(file != NULL);
+
+    for (uint i = 0; i < MAX_FLOW; ++i)
+    {
+        struct table *t = &table[i];
+
+        if (t->jump != NULL && t->data == macro->data)
+        {
+            if (f.e3.compile && !t->saved)
+            {
+                save_flow(t, file);
+            }
+
+            if (t->file != NULL)
+            {
+                if (t->busy != 0)
+                {
+                    --t->busy;
+                }
+
+                macro->data = NULL;
+
+                return;
+            }
+
+            free_table(t);
+
+            break;
+        }
+    }
+
+    free_mem(&macro->data);             // Text wasn't cached
+}
+
+
+///
+///  @brief    Finish scan of command string for O command. Until this is
+///            called, the tags found by add_tag() will not be used.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void end_tags(uint_t loop_end)
+{
+    struct table *t = find_table();
+
+    if (t == NULL || t->tag == NULL)
+    {
+        return;
+    }
+
+    t->tags_ok  = true;
+    t->parens   = (int)nparens - (int)t->nparens;
+    t->loop_end = loop_end;
+}
+
+
+///
+///  @brief    Deallocate all flow tables.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void exit_flow(void)
+{
+    for (uint i = 0; i < MAX_FLOW; ++i)
+    {
+        free_table(&table[i]);
+    }
+
+    next_table = 0;
+}
+
+
+///
+///  @brief    See if we have a cached skip from the current position in the
+///            command string. If so, we update the position, the line number,
+///            and the parenthesis count, and return the changes in the loop
+///            and conditional depths. If not, we save the starting values so
+///            that the caller can use store_flow() after skipping.
+///
+///  @returns  true if skip was found (and done), else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool find_flow(struct flow *flow)
+{
+    assert(flow != NULL);
+
+    flow->pos     = cbuf->pos;
+    flow->line    = cmd_line;
+    flow->nparens = nparens;
+    flow->loops   = 0;
+    flow->ifs     = 0;
+
+    struct table *t = find_table();
+
+    if (t == NULL)
+    {
+        return false;
+    }
+
+    const struct jump *jump = find_jump(t, flow->pos, flow->type);
+
+    if (jump->start == 0 || jump->nparens != nparens
+        || jump->e1 != f.e1.flag || jump->e2 != f.e2.flag
+        || jump->counting != (cmd_line != 0))
+    {
+        return false;
+    }
+
+    cbuf->pos = jump->end;
+    cmd_line += jump->lines;
+    nparens   = (uint)((int)nparens + jump->parens);
+
+    flow->loops = jump->loops;
+    flow->ifs   = jump->ifs;
+
+    return true;
+}
+
+
+///
+///  @brief    Find entry in hash table for skip from specified position. This
+///            is either the entry for that skip, or an unused entry.
+///
+///  @returns  Pointer to entry.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static struct jump *find_jump(struct table *t, uint_t pos,
+                              enum flow_type type)
+{
+    assert(t != NULL);
+
+    const uint mask = t->size - 1;
+    uint i = ((uint)pos * 4 + (uint)type) * 2654435761u;
+
+    for (;;)
+    {
+        struct jump *jump = &t->jump[i & mask];
+
+        if (jump->start == 0 || (jump->start == pos && jump->type == type))
+        {
+            return jump;
+        }
+
+        ++i;
+    }
+}
+
+
+///
+///  @brief    Find pre-scanned command or text operands at position in current
+///            command string, optionally adding a new (empty) entry.
+///
+///  @returns  Pointer to entry, or NULL if none.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+struct op *find_op(uint_t pos, bool create)
+{
+    struct table *t = find_table();
+
+    if (t == NULL || pos >= t->len)
+    {
+        return NULL;
+    }
+
+    if (t->index == NULL)
+    {
+        if (!create)
+        {
+            return NULL;
+        }
+
+        t->index = alloc_mem((uint_t)(sizeof(*t->index) * t->len));
+    }
+
+    uint i = t->index[pos];
+
+    if (i != 0)
+    {
+        if (create)
+        {
+            t->saved = false;
+        }
+
+        return &t->op[i - 1];
+    }
+    else if (!create)
+    {
+        return NULL;
+    }
+
+    t->saved = false;
+
+    if (t->nops == t->maxops)
+    {
+        uint_t size = (uint_t)(sizeof(*t->op) * OP_SIZE);
+
+        if (t->op == NULL)
+        {
+            t->op = alloc_mem(size);
+        }
+        else
+        {
+            t->op = expand_mem(t->op, (uint_t)(sizeof(*t->op) * t->maxops),
+                               size);
+        }
+
+        t->maxops += OP_SIZE;
+    }
+
+    struct op *op = &t->op[t->nops++];
+
+    *op = (struct op){ .entry = NULL, .end = 0 };
+
+    t->index[pos] = t->nops;
+
+    return op;
+}
+
+
+///
+///  @brief    Find table for current command string.
+///
+///  @returns  Pointer to table, or NULL if command string isn't cached.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static struct table *find_table(void)
+{
+    struct table *t = &table[last_table];
+
+    if (t->jump != NULL && t->data == cbuf->data && t->len == cbuf->len)
+    {
+        return t;
+    }
+
+    for (uint i = 0; i < MAX_FLOW; ++i)
+    {
+        t = &table[i];
+
+        if (t->jump != NULL && t->data == cbuf->data && t->len == cbuf->len)
+        {
+            last_table = i;
+
+            return t;
+        }
+    }
+
+    return NULL;
+}
+
+
+///
+///  @brief    Find entry in hash table for tag. This is either the entry for
+///            that tag, or an unused entry.
+///
+///  @returns  Pointer to entry.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static struct tag *find_tag(struct table *t, const char *text, uint_t len)
+{
+    assert(t != NULL);
+    assert(text != NULL);
+
+    const uint mask = t->tag_size - 1;
+    uint i = 2166136261u;               // FNV-1a hash of tag
+
+    for (uint_t n = 0; n < len; ++n)
+    {
+        i = (i ^ (uchar)text[n]) * 16777619u;
+    }
+
+    for (;;)
+    {
+        struct tag *tag = &t->tag[i & mask];
+
+        if (tag->text == NULL
+            || (tag->len == len && !memcmp(tag->text, text, (size_t)len)))
+        {
+            return tag;
+        }
+
+        ++i;
+    }
+}
+
+
+///
+///  @brief    See if we have a complete table of the tags in the current
+///            command string. If so, we update the parenthesis count as the
+///            scan would have done, and return the position following the
+///            first > command.
+///
+///  @returns  true if tags can be found with get_tag(), else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool find_tags(uint_t *loop_end)
+{
+    assert(loop_end != NULL);
+
+    const struct table *t = find_table();
+
+    if (t == NULL || !t->tags_ok || t->nparens != nparens
+        || t->tag_e1 != f.e1.flag || t->tag_e2 != f.e2.flag)
+    {
+        return false;
+    }
+
+    nparens   = (uint)((int)nparens + t->parens);
+    *loop_end = t->loop_end;
+
+    return true;
+}
+
+
+///
+///  @brief    Deallocate table and mark it unused.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void free_table(struct table *t)
+{
+    assert(t != NULL);
+
+    free_mem(&t->jump);
+    free_mem(&t->tag);
+    free_mem(&t->index);
+    free_mem(&t->op);
+
+    if (t->map != NULL)
+    {
+        (void)munmap(t->map, t->map_size);
+
+        t->map      = NULL;
+        t->map_size = 0;
+    }
+    else if (t->file != NULL)
+    {
+        char *data = (char *)t->data;
+
+        free_mem(&data);
+    }
+
+    free_mem(&t->file);
+
+    t->data     = NULL;
+    t->len      = 0;
+    t->size     = 0;
+    t->count    = 0;
+    t->tag_size = 0;
+    t->ntags    = 0;
+    t->tags_ok  = false;
+    t->nops     = 0;
+    t->maxops   = 0;
+    t->saved    = false;
+    t->busy     = 0;
+}
+
+
+///
+///  @brief    Get tag from table built by add_tag(). Only valid if find_tags()
+///            returned true.
+///
+///  @returns  Pointer to tag, or NULL if not found.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+const struct tag *get_tag(const char *text, uint_t len)
+{
+    assert(text != NULL);
+
+    struct table *t = find_table();
+
+    assert(t != NULL && t->tags_ok);
+
+    const struct tag *tag = find_tag(t, text, len);
+
+    return (tag->text != NULL) ? tag : NULL;
+}
+
+
+///
+///  @brief    Keep text of EI command file which was read from the file, so
+///            that we can reuse it in subsequent EI commands. If there is no
+///            table available, then close_flow() will deallocate the text.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void keep_flow(const tbuffer *macro, const char *file,
+               const struct stat *source)
+{
+    assert(macro != NULL);
+    assert(macro->data != NULL);
+    assert(file != NULL);
+    assert(source != NULL);
+
+    struct table *t = new_table(macro->data, macro->len, FLOW_SIZE);
+
+    if (t != NULL)
+    {
+        set_file(t, file, source);
+    }
+}
+
+
+///
+///  @brief    Load text and tables for EI command file, either from a previous
+///            EI command for the same file, or from a compiled file, if it
+///            exists and is up to date. In the latter case, the compiled file
+///            is mapped into memory, and the text is used from there.
+///
+///  @returns  true if text and tables loaded, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool load_flow(tbuffer *macro, const char *file, const struct stat *source)
+{
+    assert(macro != NULL);
+    assert(file != NULL);
+    assert(source != NULL);
+
+    for (uint i = 0; i < MAX_FLOW; ++i)
+    {
+        struct table *t = &table[i];
+
+        if (t->file == NULL || strcmp(t->file, file) != 0)
+        {
+            continue;
+        }
+        else if (match_file(t, file, source))
+        {
+            ++t->busy;
+
+            macro->data = (char *)t->data;
+            macro->size = macro->len = t->len;
+            macro->pos  = 0;
+
+            return true;
+        }
+        else if (t->busy == 0)
+        {
+            free_table(t);              // File has changed
+        }
+    }
+
+    char name[strlen(file) + sizeof(FLOW_TYPE)];
+
+    (void)snprintf(name, sizeof(name), "%s%s", file, FLOW_TYPE);
+
+    int fd = open(name, O_RDONLY);
+
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    struct stat file_stat;
+    void *map = MAP_FAILED;
+
+    if (fstat(fd, &file_stat) == 0
+        && (size_t)file_stat.st_size > sizeof(struct header))
+    {
+        map = mmap(NULL, (size_t)file_stat.st_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE, fd, (off_t)0);
+    }
+
+    (void)close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // Make sure that the compiled file was written by this version of TECO,
+    // that it's for the current version of the command file, and that its
+    // size is what the header says it should be.
+
+    const struct header *header = map;
+    const size_t size = (size_t)file_stat.st_size;
+    uint sizes[4];
+
+    set_sizes(sizes);
+
+    if (memcmp(header->magic, FLOW_MAGIC, sizeof(FLOW_MAGIC))
+        || header->version != FLOW_VERSION
+        || memcmp(header->sizes, sizes, sizeof(sizes))
+        || header->len == 0 || (off_t)header->len != source->st_size
+        || header->mtime != (long)source->st_mtim.tv_sec
+        || header->mtime_ns != (long)source->st_mtim.tv_nsec
+        || size != align_flow(header->len)
+                   + header->njumps * sizeof(struct jump)
+                   + header->ntags * sizeof(struct tag_entry)
+                   + header->nops * sizeof(struct op_entry)
+        || header->checksum != checksum((char *)map + sizeof(*header),
+                                        header->len))
+    {
+        (void)munmap(map, size);
+
+        return false;
+    }
+
+    char *data = (char *)map + sizeof(*header);
+    uint tsize = FLOW_SIZE;
+
+    while ((header->njumps + 1) * 4 > tsize * 3)
+    {
+        tsize *= 2;
+    }
+
+    struct table *t = new_table(data, header->len, tsize);
+
+    if (t == NULL)
+    {
+        (void)munmap(map, size);
+
+        return false;
+    }
+
+    t->map      = map;
+    t->map_size = size;
+
+    if (!load_table(t, header))
+    {
+        free_table(t);
+
+        return false;
+    }
+
+    t->saved = true;
+
+    set_file(t, file, source);
+
+    macro->data = data;
+    macro->size = macro->len = header->len;
+    macro->pos  = 0;
+
+    return true;
+}
+
+
+///
+///  @brief    Load skips, tags, and ops from compiled file into table.
+///
+///  @returns  true if entries are valid, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool load_table(struct table *t, const struct header *header)
+{
+    assert(t != NULL);
+    assert(header != NULL);
+
+    const char *p = t->map + align_flow(t->len);
+    const struct jump *jump = (const void *)p;
+
+    for (uint i = 0; i < header->njumps; ++i, ++jump)
+    {
+        if (jump->start == 0 || jump->start >= t->len || jump->end > t->len
+            || jump->type < FLOW_LOOP || jump->type > FLOW_ELSE)
+        {
+            return false;
+        }
+
+        struct jump *entry = find_jump(t, jump->start, jump->type);
+
+        if (entry->start != 0)
+        {
+            return false;
+        }
+
+        *entry = *jump;
+
+        ++t->count;
+    }
+
+    const struct tag_entry *tag = (const void *)jump;
+
+    if (header->tags_ok)
+    {
+        t->tag_size = TAG_SIZE;
+
+        while ((header->ntags + 1) * 4 > t->tag_size * 3)
+        {
+            t->tag_size *= 2;
+        }
+
+        t->tag = alloc_mem((uint_t)(sizeof(*t->tag) * t->tag_size));
+
+        for (uint i = 0; i < header->ntags; ++i, ++tag)
+        {
+            if (tag->text > t->len || tag->tag.len > t->len - tag->text
+                || tag->tag.pos > t->len)
+            {
+                return false;
+            }
+
+            const char *text = t->data + tag->text;
+            struct tag *entry = find_tag(t, text, tag->tag.len);
+
+            if (entry->text != NULL)
+            {
+                return false;
+            }
+
+            *entry = tag->tag;
+
+            entry->text = text;
+
+            ++t->ntags;
+        }
+
+        t->tags_ok  = true;
+        t->tag_e1   = header->tag_e1;
+        t->tag_e2   = header->tag_e2;
+        t->nparens  = header->nparens;
+        t->parens   = header->parens;
+        t->loop_end = header->loop_end;
+    }
+    else if (header->ntags != 0)
+    {
+        return false;
+    }
+
+    if (header->nops == 0)
+    {
+        return true;
+    }
+
+    const struct op_entry *op = (const void *)tag;
+
+    t->index  = alloc_mem((uint_t)(sizeof(*t->index) * t->len));
+    t->maxops = (header->nops + OP_SIZE - 1) / OP_SIZE * OP_SIZE;
+    t->op     = alloc_mem((uint_t)(sizeof(*t->op) * t->maxops));
+
+    for (uint i = 0; i < header->nops; ++i, ++op)
+    {
+        if (op->pos >= t->len || t->index[op->pos] != 0
+            || op->op.next > t->len || op->op.end > t->len
+            || op->op.text1 > t->len || op->op.len1 > t->len - op->op.text1
+            || op->op.text2 > t->len || op->op.len2 > t->len - op->op.text2)
+        {
+            return false;
+        }
+
+        struct op *entry = &t->op[t->nops++];
+
+        *entry = op->op;
+
+        entry->entry = NULL;
+
+        if (op->decoded
+            && (entry->entry = find_cmd(entry->c1, entry->c2)) == NULL)
+        {
+            return false;
+        }
+
+        t->index[op->pos] = t->nops;
+    }
+
+    return true;
+}
+
+
+///
+///  @brief    See if table is for current version of EI command file.
+///
+///  @returns  true if table matches file, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool match_file(const struct table *t, const char *file,
+                       const struct stat *source)
+{
+    assert(t != NULL);
+    assert(file != NULL);
+    assert(source != NULL);
+
+    return (t->file != NULL && !strcmp(t->file, file)
+            && t->dev == source->st_dev && t->ino == source->st_ino
+            && (off_t)t->len == source->st_size
+            && t->mtime == (long)source->st_mtim.tv_sec
+            && t->mtime_ns == (long)source->st_mtim.tv_nsec);
+}
+
+
+///
+///  @brief    Get a table for a new command string, reusing the table for a
+///            previous version of it, or an unused table, or if necessary the
+///            oldest table (unless that is for an active EI command).
+///
+///  @returns  Pointer to table, or NULL if none available.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static struct table *new_table(const char *data, uint_t len, uint size)
+{
+    assert(data != NULL);
+
+    struct table *t = NULL;
+
+    for (uint i = 0; i < MAX_FLOW; ++i)
+    {
+        if (table[i].data == data)
+        {
+            t = &table[i];              // Text has changed, so start over
+
+            break;
+        }
+        else if (t == NULL && table[i].jump == NULL)
+        {
+            t = &table[i];              // Use first unused table
+        }
+    }
+
+    // If all in use, reuse oldest one
+
+    for (uint i = 0; t == NULL && i < MAX_FLOW; ++i)
+    {
+        struct table *old = &table[next_table++ % MAX_FLOW];
+
+        if (old->busy == 0)
+        {
+            t = old;
+        }
+    }
+
+    if (t == NULL)
+    {
+        return NULL;
+    }
+
+    free_table(t);
+
+    t->data = data;
+    t->len  = len;
+    t->size = size;
+    t->jump = alloc_mem((uint_t)(sizeof(*t->jump) * t->size));
+
+    return t;
+}
+
+
+///
+///  @brief    Enable caching of skips for a macro about to be executed. The
+///            caller is responsible for calling reset_flow() if the text of
+///            the macro is subsequently changed or deallocated.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void open_flow(const tbuffer *macro)
+{
+    assert(macro != NULL);
+    assert(macro->data != NULL);
+
+    for (uint i = 0; i < MAX_FLOW; ++i)
+    {
+        if (table[i].data == macro->data && table[i].len == macro->len)
+        {
+            return;                     // Already have table
+        }
+    }
+
+    (void)new_table(macro->data, macro->len, FLOW_SIZE);
+}
+
+
+///
+///  @brief    Mark all EI command files as inactive, after an error or other
+///            condition which aborted their execution.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void release_flow(void)
+{
+    for (uint i = 0; i < MAX_FLOW; ++i)
+    {
+        table[i].busy = 0;
+    }
+}
+
+
+///
+///  @brief    Discard any cached skips for command string. This must be called
+///            whenever the text of a Q-register is changed or deallocated.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void reset_flow(const char *data)
+{
+    if (data == NULL)
+    {
+        return;
+    }
+
+    for (uint i = 0; i < MAX_FLOW; ++i)
+    {
+        if (table[i].data == data)
+        {
+            free_table(&table[i]);
+        }
+    }
+}
+
+
+///
+///  @brief    Save tables for EI command file in compiled file. This is written
+///            to a temporary file which is then renamed, so that the compiled
+///            file can be replaced while it is mapped. Any errors are ignored,
+///            since the compiled file is only used to speed up EI commands.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void save_flow(const struct table *t, const char *file)
+{
+    assert(t != NULL);
+    assert(file != NULL);
+
+    struct stat source;
+
+    if (stat(file, &source) != 0 || source.st_size != (off_t)t->len)
+    {
+        return;                         // Command file has changed
+    }
+
+    char name[strlen(file) + sizeof(FLOW_TYPE)];
+    char temp[sizeof(name) + sizeof(".tmp")];
+
+    (void)snprintf(name, sizeof(name), "%s%s", file, FLOW_TYPE);
+    (void)snprintf(temp, sizeof(temp), "%s.tmp", name);
+
+    FILE *fp = fopen(temp, "wb");
+
+    if (fp == NULL)
+    {
+        return;
+    }
+
+    struct header header;
+
+    memset(&header, NUL, sizeof(header));
+    memcpy(header.magic, FLOW_MAGIC, sizeof(FLOW_MAGIC));
+    set_sizes(header.sizes);
+
+    header.version  = FLOW_VERSION;
+    header.checksum = checksum(t->data, t->len);
+    header.len      = t->len;
+    header.mtime    = (long)source.st_mtim.tv_sec;
+    header.mtime_ns = (long)source.st_mtim.tv_nsec;
+    header.njumps   = t->count;
+    header.nops     = t->nops;
+
+    if (t->tags_ok)
+    {
+        header.ntags    = t->ntags;
+        header.tags_ok  = true;
+        header.tag_e1   = t->tag_e1;
+        header.tag_e2   = t->tag_e2;
+        header.nparens  = t->nparens;
+        header.parens   = t->parens;
+        header.loop_end = t->loop_end;
+    }
+
+    static const char pad[8] = { NUL };
+
+    (void)fwrite(&header, sizeof(header), 1uL, fp);
+    (void)fwrite(t->data, 1uL, (size_t)t->len, fp);
+    (void)fwrite(pad, 1uL, align_flow(t->len) - sizeof(header) - t->len, fp);
+
+    for (uint i = 0; i < t->size; ++i)
+    {
+        if (t->jump[i].start != 0)
+        {
+            (void)fwrite(&t->jump[i], sizeof(t->jump[i]), 1uL, fp);
+        }
+    }
+
+    for (uint i = 0; header.tags_ok && i < t->tag_size; ++i)
+    {
+        if (t->tag[i].text != NULL)
+        {
+            struct tag_entry entry;
+
+            memset(&entry, NUL, sizeof(entry));
+
+            entry.text     = (uint_t)(t->tag[i].text - t->data);
+            entry.tag      = t->tag[i];
+            entry.tag.text = NULL;
+
+            (void)fwrite(&entry, sizeof(entry), 1uL, fp);
+        }
+    }
+
+    for (uint_t pos = 0; t->index != NULL && pos < t->len; ++pos)
+    {
+        if (t->index[pos] != 0)
+        {
+            struct op_entry entry;
+
+            memset(&entry, NUL, sizeof(entry));
+
+            entry.pos      = pos;
+            entry.op       = t->op[t->index[pos] - 1];
+            entry.decoded  = (entry.op.entry != NULL);
+            entry.op.entry = NULL;
+
+            (void)fwrite(&entry, sizeof(entry), 1uL, fp);
+        }
+    }
+
+    bool error = (ferror(fp) != 0);
+
+    if (fclose(fp) != 0 || error || rename(temp, name) != 0)
+    {
+        (void)remove(temp);
+    }
+}
+
+
+///
+///  @brief    Save name and attributes of EI command file for table, and mark
+///            the file as active.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void set_file(struct table *t, const char *file,
+                     const struct stat *source)
+{
+    assert(t != NULL);
+    assert(file != NULL);
+    assert(source != NULL);
+
+    free_mem(&t->file);
+
+    t->file     = alloc_mem((uint_t)strlen(file) + 1);
+    t->dev      = source->st_dev;
+    t->ino      = source->st_ino;
+    t->mtime    = (long)source->st_mtim.tv_sec;
+    t->mtime_ns = (long)source->st_mtim.tv_nsec;
+    t->busy     = 1;
+
+    strcpy(t->file, file);
+}
+
+
+///
+///  @brief    Set sizes of header and entries for compiled files, so that we
+///            don't try to use files written by an incompatible build.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void set_sizes(uint sizes[4])
+{
+    sizes[0] = (uint)sizeof(struct header);
+    sizes[1] = (uint)sizeof(struct jump);
+    sizes[2] = (uint)sizeof(struct tag_entry);
+    sizes[3] = (uint)sizeof(struct op_entry);
+}
+
+
+///
+///  @brief    Start scan of command string for O command.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void start_tags(void)
+{
+    struct table *t = find_table();
+
+    if (t == NULL)
+    {
+        return;
+    }
+
+    free_mem(&t->tag);
+
+    t->saved    = false;
+    t->tag_size = TAG_SIZE;
+    t->ntags    = 0;
+    t->tags_ok  = false;
+    t->tag_e1   = f.e1.flag;
+    t->tag_e2   = f.e2.flag;
+    t->nparens  = nparens;
+    t->tag      = alloc_mem((uint_t)(sizeof(*t->tag) * t->tag_size));
+}
+
+
+///
+///  @brief    Save skip from position found by find_flow() to the current
+///            position, if the current command string is being cached.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void store_flow(const struct flow *flow)
+{
+    assert(flow != NULL);
+    assert(flow->pos != 0);
+
+    struct table *t = find_table();
+
+    if (t == NULL)
+    {
+        return;
+    }
+
+    // Keep the table no more than 3/4 full, so that probes are short.
+
+    if ((t->count + 1) * 4 > t->size * 3)
+    {
+        struct jump *old = t->jump;
+        uint size = t->size;
+
+        t->size *= 2;
+        t->jump = alloc_mem((uint_t)(sizeof(*t->jump) * t->size));
+
+        for (uint i = 0; i < size; ++i)
+        {
+            if (old[i].start != 0)
+            {
+                *find_jump(t, old[i].start, old[i].type) = old[i];
+            }
+        }
+
+        free_mem(&old);
+    }
+
+    struct jump *jump = find_jump(t, flow->pos, flow->type);
+
+    if (jump->start == 0)
+    {
+        ++t->count;
+    }
+
+    t->saved = false;
+
+    jump->start    = flow->pos;
+    jump->end      = cbuf->pos;
+    jump->lines    = cmd_line - flow->line;
+    jump->e1       = f.e1.flag;
+    jump->e2       = f.e2.flag;
+    jump->nparens  = flow->nparens;
+    jump->parens   = (int)nparens - (int)flow->nparens;
+    jump->loops    = flow->loops;
+    jump->ifs      = flow->ifs;
+    jump->type     = flow->type;
+    jump->counting = (flow->line != 0);
+}
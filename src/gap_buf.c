@@ -35,6 +35,7 @@
 #include "editbuf.h"
 #include "eflags.h"
 #include "page.h"
+#include "stats.h"
 #include "term.h"
 
 
@@ -155,6 +156,8 @@ int add_ebuf(int c)
 
     eb.buf[eb.left++] = (uchar)c;
 
+    ++stats[STAT_ADDS];
+
     // If we have no data in buffer, then we're on page 0, but
     // as soon as we add a character, then we're on page 1.
 
@@ -198,6 +201,57 @@ int add_ebuf(int c)
 }
 
 
+///
+///  @brief    Replace contents of edit buffer with a block of text, without
+///            copying it. The block becomes the new edit buffer, with the gap
+///            at the end, and is made at least as big as the old buffer.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void attach_ebuf(char *block, uint_t len, uint_t size)
+{
+    assert(eb.buf != NULL);             // Error if no edit buffer
+    assert(block != NULL);              // Error if no new block
+    assert(len <= size);                // Error if text won't fit
+
+    if (size < eb.size)
+    {
+        block = expand_mem(block, size, eb.size - size);
+        size  = eb.size;
+    }
+
+    free_mem(&eb.buf);
+
+    track_mem(MEM_EBUF, eb.size, size);
+
+    eb.buf   = (uchar *)block;
+    eb.size  = size;
+    eb.left  = len;
+    eb.right = 0;
+    eb.gap   = size - len;
+
+    t.Z   = (int_t)len;
+    t.dot = t.B;
+
+    // Same as add_ebuf(): as soon as we have data, we're on page 1.
+
+    if (len != 0 && page_count() == 0)
+    {
+        set_page(1);
+    }
+
+#if     defined(DISPLAY_MODE)
+
+    ebuf_changed = true;
+    dot_changed = true;
+
+#endif
+
+}
+
+
 ///
 ///  @brief    Delete n chars relative to current position.
 ///
@@ -212,6 +266,8 @@ void delete_ebuf(int_t nbytes)
         return;
     }
 
+    ++stats[STAT_DELETES];
+
     if (t.dot == 0 && nbytes == t.Z)    // Special case for HK command
     {
         eb.left = eb.right = t.Z = 0;
@@ -264,6 +320,53 @@ void delete_ebuf(int_t nbytes)
 }
 
 
+///
+///  @brief    Detach text from edit buffer without copying it. We close up the
+///            gap so that the text is contiguous, trim the block to just hold
+///            the text and a trailing NUL, and then allocate a new, empty edit
+///            buffer of the same size as the old one.
+///
+///  @returns  Block containing text.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+char *detach_ebuf(void)
+{
+    assert(eb.buf != NULL);             // Error if no edit buffer
+
+    shift_left(eb.right);               // Move gap to end of buffer
+
+    uint_t len = eb.left;
+    char *block = (char *)eb.buf;
+
+    if (len + 1 < eb.size)
+    {
+        block = shrink_mem(block, eb.size, eb.size - (len + 1));
+    }
+    else if (len + 1 > eb.size)         // Buffer is full, so no room for NUL
+    {
+        block = expand_mem(block, eb.size, (uint_t)1);
+    }
+
+    block[len] = NUL;
+
+    eb.buf   = alloc_mem(eb.size);
+    eb.left  = eb.right = 0;
+    eb.gap   = eb.size;
+
+    t.Z = t.dot = 0;
+
+#if     defined(DISPLAY_MODE)
+
+    ebuf_changed = true;
+    dot_changed = true;
+
+#endif
+
+    return block;
+}
+
+
 ///
 ///  @brief    Clean up memory before we exit from TECO.
 ///
@@ -273,7 +376,50 @@ void delete_ebuf(int_t nbytes)
 
 void exit_ebuf(void)
 {
-    free_mem(&eb.buf);
+    if (eb.buf != NULL)
+    {
+        track_mem(MEM_EBUF, eb.size, (uint_t)0);
+
+        free_mem(&eb.buf);
+    }
+}
+
+
+///
+///  @brief    Get pointer to contiguous text at nth character before or after
+///            dot, and reduce the no. of bytes requested to what is available.
+///
+///  @returns  Pointer to text, or NULL if position outside of edit buffer.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+const char *getblock_ebuf(int_t n, uint_t *nbytes)
+{
+    assert(nbytes != NULL);
+
+    uint_t pos = (uint_t)(t.dot + n);
+    uint_t avail;
+
+    if (pos < eb.left)
+    {
+        avail = eb.left - pos;
+    }
+    else if (pos < eb.left + eb.right)
+    {
+        avail = eb.left + eb.right - pos;
+        pos  += eb.gap;
+    }
+    else
+    {
+        return NULL;
+    }
+
+    if (*nbytes > avail)
+    {
+        *nbytes = avail;
+    }
+
+    return (const char *)eb.buf + pos;
 }
 
 
@@ -378,6 +524,8 @@ void init_ebuf(void)
     assert(eb.buf == NULL);             // Double initialization is an error
 
     eb.buf = alloc_mem(eb.size);
+
+    track_mem(MEM_EBUF, (uint_t)0, eb.size);
 }
 
 
@@ -535,6 +683,11 @@ void setsize_ebuf(uint_t nbytes)
 
     shift_right(eb.right);              // Restore the gap
 
+    ++stats[STAT_RESIZES];
+    stats[STAT_RESIZE_BYTES] += newsize;
+
+    track_mem(MEM_EBUF, eb.size, newsize);
+
     eb.size = newsize;
     eb.gap  = eb.size - (eb.left + eb.right);
 
@@ -573,6 +726,9 @@ static void shift_left(uint_t nbytes)
     eb.left  += nbytes;
     eb.right -= nbytes;
 
+    ++stats[STAT_GAP_MOVES];
+    stats[STAT_GAP_BYTES] += nbytes;
+
     memmove(dst, src, (size_t)nbytes);
 }
 
@@ -589,6 +745,9 @@ static void shift_right(uint_t nbytes)
     eb.left  -= nbytes;
     eb.right += nbytes;
 
+    ++stats[STAT_GAP_MOVES];
+    stats[STAT_GAP_BYTES] += nbytes;
+
     uchar *src = eb.buf + eb.left;
     uchar *dst = eb.buf + eb.size - eb.right;
 
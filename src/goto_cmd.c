@@ -36,6 +36,7 @@
 #include "estack.h"
 #include "exec.h"
 #include "file.h"
+#include "flow.h"
 #include "term.h"
 
 
@@ -126,9 +127,56 @@ static void find_tag(const char *orig_tag)
         throw(E_BAT, tag.data);         // Bad tag
     }
 
-    struct cmd cmd = null_cmd;          // Dummy command block for skip_cmd()
     uint_t loop_start = getloop_start(); // Start of current loop (0 if none)
     uint_t loop_end = (uint_t)EOF;      // End of current loop
+
+    // If we've already scanned this command string, then use its tag table.
+
+    if (find_tags(&loop_end))
+    {
+        if (loop_start == 0)
+        {
+            loop_end = (uint_t)EOF;
+        }
+
+        const struct tag *p = get_tag(tag.data, tag.len);
+
+        if (p == NULL)
+        {
+            throw(E_TAG, tag.data);     // Missing tag
+        }
+        else if (p->ifs != 0)
+        {
+            throw(E_LOC, tag.data);     // Invalid location
+        }
+        else if (p->loop != 0 && (p->pos < loop_start || p->pos > loop_end))
+        {
+            throw(E_LOC, tag.data);     // Invalid location
+        }
+
+        if (f.trace.enable)
+        {
+            tprint("!%.*s!", (int)p->len, p->text);
+        }
+
+        if (p->dup)
+        {
+            throw(E_DUP, tag.data);     // Duplicate tag
+        }
+
+        init_x();                       // Reinitialize expression stack
+
+        setloop_depth(p->loop + getloop_depth());
+        setif_depth(p->ifs);
+
+        cmd_line = p->line;             // Use the tag's line number
+        cbuf->pos = p->pos;             // Execute goto
+
+        return;
+    }
+
+    struct cmd cmd = null_cmd;          // Dummy command block for skip_cmd()
+    uint_t first_end = (uint_t)EOF;     // End of first loop
     uint loop_depth = 0;                // Initial loop depth
     uint if_depth = 0;                  // Current if/else depth
     uint_t tag_pos = 0;                 // Position of tag
@@ -140,6 +188,8 @@ static void find_tag(const char *orig_tag)
     cmd_line = 1;                       // Start command at line 1
     cbuf->pos = 0;                      // Start at beginning of command
 
+    start_tags();
+
     // Scan entire command string to verify that we have
     // one and only one instance of the specified tag.
 
@@ -165,6 +215,11 @@ static void find_tag(const char *orig_tag)
             case '>':                   // End of loop
                 --loop_depth;
 
+                if (first_end == (uint_t)EOF)
+                {
+                    first_end = cbuf->pos;
+                }
+
                 // Check for end of loop the O command may be in
 
                 if (loop_start != 0 && loop_end == (uint_t)EOF)
@@ -175,6 +230,21 @@ static void find_tag(const char *orig_tag)
                 break;
 
             case '!':                   // Start of tag/comment
+                if (cmd.c2 != '!' && cmd.text1.data != NULL)
+                {
+                    struct tag found =
+                    {
+                        .text = cmd.text1.data,
+                        .len  = cmd.text1.len,
+                        .pos  = cbuf->pos,
+                        .line = cmd_line,
+                        .loop = loop_depth,
+                        .ifs  = if_depth,
+                    };
+
+                    add_tag(&found);
+                }
+
                 if (cmd.c2 != '!'
                     && cmd.text1.len == tag.len
                     && !memcmp(cmd.text1.data, tag.data, (size_t)tag.len))
@@ -229,6 +299,8 @@ static void find_tag(const char *orig_tag)
         }
     }
 
+    end_tags(first_end);
+
     if (tag_pos == 0)                   // Did we find the tag?
     {
         cmd_line = saved_line;          // Restore original line number
@@ -33,6 +33,7 @@
 #include "errcodes.h"
 #include "estack.h"
 #include "exec.h"
+#include "flow.h"
 #include "term.h"
 
 
@@ -84,7 +85,32 @@ static void endif(struct cmd *unused, bool else_ok)
         throw(E_MAP);                   // Missing apostrophe
     }
 
+    struct flow flow = { .type = else_ok ? FLOW_ELSE : FLOW_IF };
+
+    // Use cached skip if we have one, unless we need to check loops. The skip
+    // ended at a | command if it didn't change the conditional depth.
+
+    if (!f.e2.quote && find_flow(&flow))
+    {
+        setloop_depth((uint)((int)getloop_depth() + flow.loops));
+
+        quote.depth = (uint)((int)quote.depth + flow.ifs);
+
+        if (flow.ifs == 0)
+        {
+            quote.start_else[quote.depth] = cbuf->pos;
+        }
+
+        if (f.trace.enable)
+        {
+            echo_in(flow.ifs == 0 ? '|' : '\'');
+        }
+
+        return;
+    }
+
     const uint start_if = quote.depth;  // Initial conditional depth
+    const uint start_loop = getloop_depth(); // Initial loop depth
 
     do
     {
@@ -158,6 +184,14 @@ static void endif(struct cmd *unused, bool else_ok)
         }
 
     } while (quote.depth >= start_if);
+
+    if (!f.e2.quote)
+    {
+        flow.loops = (int)getloop_depth() - (int)start_loop;
+        flow.ifs   = (int)quote.depth - (int)start_if;
+
+        store_flow(&flow);
+    }
 }
 
 
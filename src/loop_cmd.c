@@ -32,6 +32,7 @@
 #include "errcodes.h"
 #include "estack.h"
 #include "exec.h"
+#include "flow.h"
 #include "term.h"
 
 
@@ -99,6 +100,17 @@ static void endloop(struct cmd *cmd, bool pop_ok)
 {
     assert(cmd != NULL);
 
+    struct flow flow = { .type = FLOW_LOOP };
+
+    // Use cached skip if we have one, unless we need to check conditionals.
+
+    if (!f.e2.loop && find_flow(&flow))
+    {
+        pop_loop(pop_ok);
+
+        return;
+    }
+
     uint level = 1;                     // Nesting level
     uint if_depth = getif_depth();      // Conditional depth
 
@@ -141,6 +153,11 @@ static void endloop(struct cmd *cmd, bool pop_ok)
 
     setif_depth(if_depth);
 
+    if (!f.e2.loop)
+    {
+        store_flow(&flow);
+    }
+
     pop_loop(pop_ok);
 }
 
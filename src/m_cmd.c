@@ -31,6 +31,7 @@
 #include "errcodes.h"
 #include "estack.h"
 #include "exec.h"
+#include "flow.h"
 #include "qreg.h"
 
 
@@ -92,9 +93,13 @@ void exec_M(struct cmd *cmd)
     }
 
     // We make a private copy of the Q-register, since some of the structure
-    // members can get modified while processing the macro (esp. len).
+    // members can get modified while processing the macro (esp. len). The
+    // text itself is held until the macro ends, so that the macro is free to
+    // modify or delete the Q-register it is executing from.
 
-    tbuffer macro = qreg->text;
+    tbuffer macro = hold_qtext(cmd->qindex);
+
+    open_flow(&macro);                  // Cache flow targets for macro
 
     if (cmd->colon || cmd->qlocal)      // :Mq or using local Q-register?
     {
@@ -108,6 +113,8 @@ void exec_M(struct cmd *cmd)
 
         pop_qlocal();
     }
+
+    release_qtext();
 }
 
 
@@ -196,6 +203,19 @@ void exec_macro(tbuffer *macro, struct cmd *cmd)
 }
 
 
+///
+///  @brief    Get current macro depth.
+///
+///  @returns  No. of nested M commands being executed.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint getmacro_depth(void)
+{
+    return macro_depth;
+}
+
+
 ///
 ///  @brief    Reset macro depth.
 ///
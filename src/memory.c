@@ -25,6 +25,7 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -32,6 +33,7 @@
 #include "teco.h"
 #include "errcodes.h"
 #include "exec.h"
+#include "stats.h"
 
 
 // The following conditional code is used to check for memory leaks when we
@@ -43,29 +45,41 @@
 
 #define plural(x) (((x) == 1) ? "" : "s") ///< Check for plural/non-plural no.
 
+#define MBLOCK_MIN  1024            ///< Initial no. of slots in block table
+
 ///  @struct mblock
 ///
-///  This structure defines a block that is used in a doubly-linked list to
-///  keep track of TECO memory allocations and deallocations. The mroot vari-
-///  able points to the first block in the list, which is also always the most
-///  recently added block. And the msize variable is the sum of the sizes of
-///  all currently allocated memory (excluding the blocks for this list). At
-///  program exit, the list should be empty, but if it is not, we will use the
-///  information in each block to print an error message with the address and
+///  This structure defines an entry in an open-addressing hash table that is
+///  used to keep track of TECO memory allocations and deallocations, so that
+///  each allocation, reallocation, or deallocation takes constant time. An
+///  entry is empty if its address is NULL, and deleted if its address is
+///  that of the mdeleted variable. The msize variable is the sum of the sizes
+///  of all currently allocated memory (excluding the table itself). At pro-
+///  gram exit, the table should be empty, but if it is not, we will use the
+///  information in each entry to print an error message with the address and
 ///  size of the undeallocated memory.
+///
+///  If MEMCHECK_VERBOSE is defined, we also print a line for each allocation
+///  and reallocation.
 
 struct mblock
 {
-    struct mblock *prev;                ///< Previous block in linked list
-    struct mblock *next;                ///< Next block in linked list
     const char *addr;                   ///< calloc'd memory block
     uint_t size;                        ///< Size of block in bytes
 };
 
-static struct mblock *mroot = NULL;     ///< Root of memory block list
+static struct mblock *mtable = NULL;    ///< Hash table of memory blocks
+
+static uint_t mtable_size = 0;          ///< No. of slots in hash table
+
+static uint_t mtable_used = 0;          ///< No. of slots used or deleted
+
+static const char mdeleted = '\0';      ///< Marker for deleted slots
 
 static uint_t msize = 0;                ///< Total memory allocated, in bytes
 
+static uint_t maxsize = 0;              ///< High-water mark for allocated bytes
+
 static uint nallocs = 0;                ///< Total no. of blocks allocated
 
 static uint nblocks = 0;                ///< No. of blocks currently allocated
@@ -78,7 +92,11 @@ static void add_mblock(void *p1, uint_t size);
 
 static void delete_mblock(void *p1);
 
-static struct mblock*find_mblock(void *p1);
+static struct mblock*find_mblock(const void *p1);
+
+static uint_t hash_mblock(const void *p1);
+
+static void resize_mblocks(void);
 
 #endif
 
@@ -96,27 +114,32 @@ static void add_mblock(void *p1, uint_t size)
 {
     assert(p1 != NULL);                 // Error if no memory block
 
-    // Note: We don't call alloc_mem() here, since it calls us.
-
-    struct mblock *mblock = calloc(1ul, sizeof(*mblock));
+    if ((mtable_used + 1) * 2 > mtable_size)
+    {
+        resize_mblocks();
+    }
 
-    assert(mblock != NULL);             // Error if calloc() failed
+    uint_t mask = mtable_size - 1;
+    uint_t i = hash_mblock(p1);
 
-    mblock->prev = NULL;
-    mblock->next = mroot;
+    while (mtable[i].addr != NULL && mtable[i].addr != &mdeleted)
+    {
+        i = (i + 1) & mask;
+    }
 
-    if (mroot != NULL)
+    if (mtable[i].addr == NULL)
     {
-        mroot->prev = mblock;
+        ++mtable_used;
     }
 
-    mblock->addr = p1;
-    mblock->size = size;
+    mtable[i].addr = p1;
+    mtable[i].size = size;
     msize += size;
-    mroot = mblock;
 
-    tprint("%s(): new block at %p, size = %lu\n", __func__, mblock->addr,
-           (size_t)mblock->size);
+    if (maxsize < msize)
+    {
+        maxsize = msize;
+    }
 
     ++nallocs;
 
@@ -145,10 +168,19 @@ void *alloc_mem(uint_t size)
         throw(E_MEM);                   // Memory overflow
     }
 
+    ++stats[STAT_ALLOCS];
+    stats[STAT_ALLOC_BYTES] += size;
+
 #if     defined(MEMCHECK)
 
     add_mblock(p1, size);
 
+#if     defined(MEMCHECK_VERBOSE)
+
+    tprint("%s(): new block at %p, size = %lu\n", __func__, p1, (size_t)size);
+
+#endif
+
 #endif
 
     return p1;
@@ -180,57 +212,72 @@ tbuffer alloc_tbuf(uint_t size)
 
 
 ///
-///  @brief    Delete memory block.
+///  @brief    Append text to TECO buffer. If the buffer needs to be expanded,
+///            then we at least double its size, so that the cost of appending
+///            text is proportional to the total amount of text appended.
 ///
 ///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-#if     defined(MEMCHECK)
-
-static void delete_mblock(void *p1)
+void append_tbuf(tbuffer *tbuf, const char *data, uint_t len)
 {
-    assert(p1 != NULL);                 // Error if NULL memory block
+    assert(tbuf != NULL);
+    assert(data != NULL);
 
-    struct mblock *p = mroot;
+    if (len == 0)
+    {
+        return;
+    }
 
-    while (p != NULL)
+    if (tbuf->data == NULL)
     {
-        if (p1 == p->addr)
+        *tbuf = alloc_tbuf((len > KB) ? len : KB);
+    }
+    else if (len > tbuf->size - tbuf->len)
+    {
+        uint_t need  = len - (tbuf->size - tbuf->len);
+        uint_t delta = (need > tbuf->size) ? need : tbuf->size;
+
+        if (tbuf->size + delta < tbuf->size)
         {
-            msize -= p->size;
+            throw(E_MEM);               // Memory overflow
+        }
 
-            if (p->prev != NULL)
-            {
-                p->prev->next = p->next;
-            }
-            else
-            {
-                mroot = p->next;
-            }
+        tbuf->data  = expand_mem(tbuf->data, tbuf->size, delta);
+        tbuf->size += delta;
+    }
 
-            if (p->next != NULL)
-            {
-                p->next->prev = p->prev;
-            }
+    memcpy(tbuf->data + tbuf->len, data, (size_t)len);
 
-            p->next = p->prev = NULL;
-            p->addr = NULL;
-            p->size = 0;
+    tbuf->len += len;
+}
 
-            // Note: We don't call free_mem() here, since it calls us.
 
-            free(p);
+///
+///  @brief    Delete memory block.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
 
-            --nblocks;
+#if     defined(MEMCHECK)
 
-            return;
-        }
+static void delete_mblock(void *p1)
+{
+    assert(p1 != NULL);                 // Error if NULL memory block
 
-        p = p->next;
-    }
+    struct mblock *mblock = find_mblock(p1);
 
-    tprint("?Can't find memory block: %p\n", p1);
+    if (mblock != NULL)
+    {
+        msize -= mblock->size;
+
+        mblock->addr = &mdeleted;
+        mblock->size = 0;
+
+        --nblocks;
+    }
 }
 
 #endif
@@ -257,8 +304,8 @@ void exit_mem(void)
     tprint("%s(): %u block%s allocated, high water mark = %u block%s\n",
            __func__, nallocs, plural(nallocs), maxblocks, plural(maxblocks));
 
-    struct mblock *p = mroot;
-    struct mblock *next;
+    tprint("%s(): high water mark = %lu byte%s\n", __func__, (size_t)maxsize,
+           plural(maxsize));
 
     if (msize != 0)
     {
@@ -266,23 +313,25 @@ void exit_mem(void)
                __func__, (size_t)msize, plural(msize), nblocks, plural(nblocks));
     }
 
-    uint i = 0;
+    uint n = 0;
 
-    while (p != NULL)
+    for (uint_t i = 0; i < mtable_size; ++i)
     {
-        tprint("%s(): allocation #%u at %p, %lu byte%s\n", __func__, ++i,
-               p->addr, (size_t)p->size, plural(p->size));
-
-        next = p->next;
-        msize -= p->size;
-        p->next = p->prev = NULL;
-        p->addr = NULL;
-        p->size = 0;
+        struct mblock *p = &mtable[i];
 
-        free(p);
+        if (p->addr != NULL && p->addr != &mdeleted)
+        {
+            tprint("%s(): allocation #%u at %p, %lu byte%s\n", __func__, ++n,
+                   p->addr, (size_t)p->size, plural(p->size));
 
-        p = next;
+            msize -= p->size;
+        }
     }
+
+    free(mtable);
+
+    mtable      = NULL;
+    mtable_size = mtable_used = 0;
 }
 
 #endif
@@ -320,20 +369,36 @@ void *expand_mem(void *p1, uint_t size, uint_t delta)
         throw(E_MEM);                   // Memory overflow
     }
 
+    ++stats[STAT_EXPANDS];
+    stats[STAT_EXPAND_BYTES] += delta;
+
 #if     defined(MEMCHECK)
 
     if (mblock != NULL)
     {
+
+#if     defined(MEMCHECK_VERBOSE)
+
+        tprint("--%s(): block at %p increased from %lu to %lu\n", __func__,
+               (void *)p2, (size_t)mblock->size, (size_t)(size + delta));
+
+#endif
+
+        // The table is keyed by address, so we have to delete the old entry
+        // and add a new one, rather than just updating it.
+
         msize -= mblock->size;
-        msize += size + delta;
 
-        uint_t oldsize = mblock->size;
+        mblock->addr = &mdeleted;
+        mblock->size = 0;
 
-        mblock->addr = p2;
-        mblock->size = size + delta;
+        --nblocks;
 
-        tprint("--%s(): block at %p increased from %lu to %lu\n", __func__,
-               mblock->addr, (size_t)oldsize, (size_t)mblock->size);
+        uint n = nallocs;
+
+        add_mblock(p2, size + delta);
+
+        nallocs = n;                    // Reallocation isn't a new block
     }
 
 #endif
@@ -355,20 +420,24 @@ void *expand_mem(void *p1, uint_t size, uint_t delta)
 
 #if     defined(MEMCHECK)
 
-static struct mblock*find_mblock(void *p1)
+static struct mblock*find_mblock(const void *p1)
 {
     assert(p1 != NULL);                 // Error if NULL memory block
 
-    struct mblock *mblock = mroot;
-
-    while (mblock != NULL)
+    if (mtable_size != 0)
     {
-        if (p1 == mblock->addr)
+        uint_t mask = mtable_size - 1;
+        uint_t i = hash_mblock(p1);
+
+        while (mtable[i].addr != NULL)
         {
-            return mblock;
-        }
+            if (mtable[i].addr == p1)
+            {
+                return &mtable[i];
+            }
 
-        mblock = mblock->next;
+            i = (i + 1) & mask;
+        }
     }
 
     tprint("?Can't find memory block: %p\n", p1);
@@ -408,6 +477,88 @@ void free_mem(void *p1)
 }
 
 
+///
+///  @brief    Hash address of memory block.
+///
+///  @returns  Index of first slot to check in hash table.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#if     defined(MEMCHECK)
+
+static uint_t hash_mblock(const void *p1)
+{
+    // Blocks are at least 16-byte aligned, so discard the low-order bits,
+    // then use Fibonacci hashing to spread the rest over the table.
+
+    unsigned long long hash = (unsigned long long)(uintptr_t)p1 >> 4;
+
+    hash *= 11400714819323198485uLL;
+
+    return (uint_t)(hash >> 32) & (mtable_size - 1);
+}
+
+#endif
+
+
+///
+///  @brief    Resize hash table of memory blocks. The table is doubled if it
+///            is more than 1/4 full of live entries, and is otherwise rebuilt
+///            at the same size to discard any deleted entries.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#if     defined(MEMCHECK)
+
+static void resize_mblocks(void)
+{
+    struct mblock *old = mtable;
+    uint_t oldsize     = mtable_size;
+
+    if (mtable_size == 0)
+    {
+        mtable_size = MBLOCK_MIN;
+    }
+    else if (nblocks * 4 > mtable_size)
+    {
+        mtable_size *= 2;
+    }
+
+    // Note: We don't call alloc_mem() here, since it calls us.
+
+    mtable = calloc((size_t)mtable_size, sizeof(*mtable));
+
+    assert(mtable != NULL);             // Error if calloc() failed
+
+    mtable_used = 0;
+
+    uint_t mask = mtable_size - 1;
+
+    for (uint_t i = 0; i < oldsize; ++i)
+    {
+        if (old[i].addr != NULL && old[i].addr != &mdeleted)
+        {
+            uint_t j = hash_mblock(old[i].addr);
+
+            while (mtable[j].addr != NULL)
+            {
+                j = (j + 1) & mask;
+            }
+
+            mtable[j] = old[i];
+
+            ++mtable_used;
+        }
+    }
+
+    free(old);
+}
+
+#endif
+
+
 ///
 ///  @brief    Shrink memory.
 ///
@@ -445,16 +596,29 @@ void *shrink_mem(void *p1, uint_t size, uint_t delta)
 
     if (mblock != NULL)
     {
+
+#if     defined(MEMCHECK_VERBOSE)
+
+        tprint("--%s(): block at %p decreased from %lu to %lu\n", __func__,
+               (void *)p2, (size_t)mblock->size, (size_t)(size - delta));
+
+#endif
+
+        // The table is keyed by address, so we have to delete the old entry
+        // and add a new one, rather than just updating it.
+
         msize -= mblock->size;
-        msize += size - delta;
 
-        uint_t oldsize = mblock->size;
+        mblock->addr = &mdeleted;
+        mblock->size = 0;
 
-        mblock->addr = p2;
-        mblock->size = size - delta;
+        --nblocks;
 
-        tprint("--%s(): block at %p decreased from %lu to %lu\n", __func__,
-               mblock->addr, (size_t)oldsize, (size_t)mblock->size);
+        uint n = nallocs;
+
+        add_mblock(p2, size - delta);
+
+        nallocs = n;                    // Reallocation isn't a new block
     }
 
 #endif
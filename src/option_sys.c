@@ -35,8 +35,12 @@
 
 #include "teco.h"
 #include "ascii.h"
+#include "each.h"
 #include "eflags.h"
 #include "file.h"
+#include "profile.h"
+#include "ring.h"
+#include "stats.h"
 #include "term.h"
 
 #include "cbuf.h"
@@ -54,15 +58,20 @@ struct options
     const char *args;       ///< --arguments (m,n)
     bool create;            ///< --create
     bool display;           ///< --display
+    const char *each;       ///< --each
     const char *execute;    ///< --execute
     bool exit;              ///< --exit
     bool formfeed;          ///< --formfeed
     const char *initial;    ///< --initial
+    uint jobs;              ///< --jobs
     char *log;              ///< --log
     const char *memory;     ///< --memory
     char *output;           ///< --output
+    const char *profile;    ///< --profile
+    const char *ring;       ///< --ring
     const char *scroll;     ///< --scroll
     bool readonly;          ///< --readonly
+    bool stats;             ///< --stats
     char *text;             ///< --text
     const char *vtedit;     ///< --vtedit
     const char *zero;       ///< --zero
@@ -79,15 +88,20 @@ static struct options options =
     .args     = NULL,
     .create   = true,
     .display  = false,
+    .each     = NULL,
     .execute  = NULL,
     .exit     = false,
     .formfeed = false,
     .initial  = NULL,
+    .jobs     = 1,
     .log      = NULL,
     .memory   = NULL,
     .output   = NULL,
+    .profile  = NULL,
     .readonly = false,
+    .ring     = NULL,
     .scroll   = NULL,
+    .stats    = false,
     .text     = NULL,
     .vtedit   = NULL,
     .zero     = NULL,
@@ -169,11 +183,56 @@ void exec_options(int argc, const char * const argv[])
 {
     assert(argv != NULL);               // Error if no argument list
 
+    if (options.profile != NULL)        // Profiling commands?
+    {
+        set_prof(options.profile);      // Yes, set file for results
+    }
+
+    if (options.ring != NULL)           // Recording commands?
+    {
+        set_ring(options.ring);         // Yes, set file for dumps
+    }
+
+    set_stats(options.stats);           // Print counters on exit if requested
+
+    if (options.each != NULL)           // Executing macro on list of files?
+    {
+        if (options.execute == NULL)
+        {
+            tprint("--each option requires --execute option\n");
+
+            exit(EXIT_FAILURE);
+        }
+        else if (optind < argc)
+        {
+            tprint("File arguments not allowed with --each option\n");
+
+            exit(EXIT_FAILURE);
+        }
+
+        set_each(options.each, options.execute, options.args, options.jobs);
+    }
+
     // Process commands that don't open a file for editing.
 
     if (options.initial)  add_cmd(false, NULL,      options.initial);
     if (options.zero)     add_cmd(false, "%sE2",    options.zero);
     if (options.log)      add_cmd(false, "EL%s\e ", options.log);
+    if (options.profile)  add_cmd(false, "0,1024E3 ", NULL);
+    if (options.ring)     add_cmd(false, "0,2048E3 ", NULL);
+
+    // With --each, the macro and files are handled by worker processes.
+
+    if (options.each != NULL)
+    {
+        if (cbuf->len != 0)             // Anything stored?
+        {
+            add_cmd(false, "\e\e");
+        }
+
+        return;
+    }
+
     if (options.text)     add_cmd(false, "I%s\e ",  options.text);
     if (options.execute)  add_cmd(true,  NULL,      options.execute);
     if (options.formfeed) add_cmd(false, "0,1E3 ",  NULL);
@@ -352,6 +411,11 @@ void init_options(
 
                 break;
 
+            case OPTION_B:
+                options.ring = (optarg != NULL) ? optarg : "";
+
+                break;
+
             case OPTION_C:
             case OPTION_c:
                 options.create = (c == 'C') ? true : false;
@@ -421,6 +485,24 @@ void init_options(
 
                 break;
 
+            case OPTION_J:
+            {
+                int nbytes;
+                int jobs;
+
+                if (sscanf(optarg, "%d%n", &jobs, &nbytes) != 1
+                    || optarg[nbytes] != NUL || jobs <= 0 || jobs > MAX_JOBS)
+                {
+                    printf("Invalid value '%s' for --jobs option\n", optarg);
+
+                    exit(EXIT_FAILURE);
+                }
+
+                options.jobs = (uint)jobs;
+
+                break;
+            }
+
             case OPTION_K:
                 if (optarg != NULL && optarg[0] != '-')
                 {
@@ -487,6 +569,16 @@ void init_options(
 
                 break;
 
+            case OPTION_P:
+                options.profile = (optarg != NULL) ? optarg : "";
+
+                break;
+
+            case OPTION_Q:
+                f.e0.batch = true;
+
+                break;
+
             case OPTION_R:
             case OPTION_r:
                 options.readonly = (c == 'R') ? true : false;
@@ -507,6 +599,11 @@ void init_options(
 
                 break;
 
+            case OPTION_U:
+                options.stats = true;
+
+                break;
+
             case OPTION_V:
                 if (optarg != NULL)
                 {
@@ -524,6 +621,11 @@ void init_options(
 
                 break;
 
+            case OPTION_W:
+                options.each = optarg;
+
+                break;
+
             case OPTION_X:
                 options.exit = true;
 
@@ -554,13 +656,19 @@ void init_options(
         }
     }
 
-    // Disable display mode if stdin has been redirected
+    // Disable display mode if stdin has been redirected, or in batch mode
 
-    if (f.e0.i_redir)
+    if (f.e0.i_redir || f.e0.batch)
     {
         options.vtedit = NULL;
     }
 
+    if (f.e0.batch)
+    {
+        options.display = false;
+        options.scroll  = NULL;
+    }
+
     if (mung && argv[optind] != NULL)
     {
         options.execute = argv[optind++];
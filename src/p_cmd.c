@@ -38,6 +38,55 @@
 #include "term.h"
 
 
+///
+///  @brief    Execute "FP" command (go to page n).
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void exec_FP(struct cmd *cmd)
+{
+    assert(cmd != NULL);
+
+    if (ofiles[ostream].fp == NULL)
+    {
+        throw(E_NFO);                   // No file for output
+    }
+
+    if (!cmd->n_set || cmd->n_arg <= 0)
+    {
+        throw(E_INA);                   // Invalid n argument
+    }
+
+    uint page  = (uint)cmd->n_arg;
+    uint count = page_seek(page, f.ctrl_e);
+
+    // If we haven't read the page we want yet, then keep reading until we
+    // get to it, or until we run out of input.
+
+    while (count < page)
+    {
+        if (!next_page(t.B, t.Z, f.ctrl_e, (bool)true))
+        {
+            if (cmd->colon)
+            {
+                push_x(FAILURE, X_OPERAND);
+            }
+
+            return;
+        }
+
+        count = page_count();
+    }
+
+    if (cmd->colon)
+    {
+        push_x(SUCCESS, X_OPERAND);
+    }
+}
+
+
 ///
 ///  @brief    Execute "P" command (write out buffer, and read next page).
 ///
@@ -175,7 +224,9 @@ void exec_P(struct cmd *cmd)
 
 bool next_page(int_t start, int_t end, bool ff, bool yank)
 {
-    if (!page_forward(ofiles[ostream].fp, start - t.dot, end - t.dot, ff))
+    FILE *fp = ofiles[ostream].fp;
+
+    if (!page_forward(fp, start - t.dot, end - t.dot, ff, yank))
     {
         if (yank)                       // Yank next page if we need to
         {
@@ -195,6 +246,25 @@ bool next_page(int_t start, int_t end, bool ff, bool yank)
 }
 
 
+///
+///  @brief    Scan "FP" command.
+///
+///  @returns  false (command is not an operand or operator).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool scan_FP(struct cmd *cmd)
+{
+    assert(cmd != NULL);
+
+    reject_m(cmd->m_set);
+    reject_dcolon(cmd->dcolon);
+    reject_atsign(cmd->atsign);
+
+    return false;
+}
+
+
 ///
 ///  @brief    Scan "P" command, which may have an optional postfix W.
 ///
@@ -26,92 +26,730 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "teco.h"
 #include "ascii.h"
 #include "editbuf.h"
 #include "eflags.h"
+#include "errcodes.h"
 #include "file.h"
 #include "page.h"
+#include "stats.h"
+
+
+#define PAGE_BLOCK  (KB * 64)           ///< Size of holding file I/O block
+
+///  @struct   page
+///  @brief    Description of each page stored in holding file.
+
+struct page
+{
+    long offset;                        ///< Offset of page in holding file
+    uint_t size;                        ///< Size of page in bytes
+    uint_t cr;                          ///< No. of added CRs in page
+    bool CR_out;                        ///< Copy of f.e3.CR_out
+    bool ff;                            ///< Append form feed to page
+};
+
+///  @struct   page_list
+///  @brief    Variable-length array of page descriptors.
+
+struct page_list
+{
+    struct page *page;                  ///< Array of page descriptors
+    uint_t count;                       ///< No. of pages in array
+    uint_t size;                        ///< No. of descriptors allocated
+};
+
+///  @struct   page_table
+///  @brief    Description of stored pages for output streams. Page data is
+///            kept in a holding file; only the descriptors are kept in memory.
+
+struct page_table
+{
+    uint count;                         ///< Current page number
+    FILE *fp;                           ///< Holding file
+    struct page_list list;              ///< Pages written forward
+    struct page_list stack;             ///< Saved page stack
+};
+
+///  @var      ptable
+///  @brief    Stored data for primary and secondary output streams.
+
+static struct page_table ptable[] =
+{
+    { .count = 0, .fp = NULL },
+    { .count = 0, .fp = NULL },
+};
+
+// Local functions
+
+static void add_page(struct page_list *list, const struct page *page);
+
+static void close_hold(uint stream);
+
+static void copy_page(struct page *page);
+
+static uint_t count_chr(const char *p, uint_t nbytes, int c);
+
+static uint_t count_lf(const char *p, uint_t nbytes, int last);
+
+static struct page make_page(int_t start, int_t end, bool ff);
+
+static bool pop_page(void);
+
+static void read_hold(char *buf, long offset, uint_t nbytes);
+
+static bool remove_page(struct page_list *list, struct page *page);
+
+static void write_page(FILE *fp, const struct page *page);
 
 
 ///
-///  @brief    Write out current page.
+///  @brief    Add page descriptor to end of array.
 ///
-///  @returns  true if already have buffer data, false if not.
+///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-bool page_forward(FILE *fp, int_t start, int_t end, bool ff)
+static void add_page(struct page_list *list, const struct page *page)
 {
-    assert(fp != NULL);                 // Error if no file block
+    assert(list != NULL);
+    assert(page != NULL);
 
-    struct page page;
-    int last = NUL;
+    if (list->count == list->size)      // Need to make array bigger?
+    {
+        uint_t size  = (uint_t)sizeof(*page);
+        uint_t delta = (list->size == 0) ? 16 : list->size;
+
+        if (list->page == NULL)
+        {
+            list->page = alloc_mem(delta * size);
+        }
+        else
+        {
+            list->page = expand_mem(list->page, list->size * size,
+                                    delta * size);
+        }
+
+        list->size += delta;
+    }
+
+    list->page[list->count++] = *page;
+}
+
+
+///
+///  @brief    Close holding file and discard all page descriptors for stream.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void close_hold(uint stream)
+{
+    struct page_table *table = &ptable[stream];
+
+    if (table->fp != NULL)
+    {
+        fclose(table->fp);              // Temp. file is deleted on close
+
+        table->fp = NULL;
+    }
+
+    free_mem(&table->list.page);
+    free_mem(&table->stack.page);
+
+    table->list.count  = table->list.size  = 0;
+    table->stack.count = table->stack.size = 0;
+}
+
+
+///
+///  @brief    Copy data in page to edit buffer. The page is read from the
+///            holding file in a single block, so memory use is bounded by the
+///            size of the page.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void copy_page(struct page *page)
+{
+    assert(page != NULL);
+
+    ++stats[STAT_PAGES_COPIED];
+
+    kill_ebuf();                        // Delete all data in edit buffer
+
+    if (page->size == 0)
+    {
+        f.ctrl_e = page->ff;
+
+        return;
+    }
+
+    char *buf = alloc_mem(page->size);
+
+    read_hold(buf, page->offset, page->size);
+
+    // If there is a form feed in the page (because the user added it while
+    // editing), then we have to treat it as an end of page marker, and only
+    // return the data after the form feed. We also reduce the count for the
+    // current page and add it back onto the list. Since the data before the
+    // form feed is unchanged, we don't need to rewrite the holding file.
+
+    uint_t nbytes = page->size;         // No. of bytes to copy to edit buffer
+    const char *p = buf;
+
+    if (!f.e3.nopage)
+    {
+        uint_t i = page->size;
+
+        while (i-- > 0)
+        {
+            if (buf[i] == FF)
+            {
+                p       += i + 1;
+                nbytes  -= i + 1;
+
+                break;
+            }
+        }
+    }
+
+    // Give the page data to the edit buffer as a single block. Since this
+    // data originated in the edit buffer, we assume it will fit, and
+    // therefore don't bother to check for warnings or errors.
+
+    if (p != buf)
+    {
+        memmove(buf, p, (size_t)nbytes);
+    }
+
+    attach_ebuf(buf, nbytes, page->size);
+
+    if (nbytes != page->size)           // Did we split the page?
+    {
+        page->size -= nbytes + 1;       // Yes, drop form feed and what follows
+        page->ff    = true;
 
-    page.size = 0;                      // No. of bytes in output page
+        add_page(&ptable[ostream].list, page);
+    }
+    else
+    {
+        f.ctrl_e = page->ff;
+    }
+}
+
+
+///
+///  @brief    Count occurrences of character in block.
+///
+///  @returns  No. of times character was found.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t count_chr(const char *p, uint_t nbytes, int c)
+{
+    assert(p != NULL);
 
-    // First pass - calculate how many characters we'll need to output
+    const char *end = p + nbytes;
+    uint_t n = 0;
 
-    for (int_t i = start; i < end; ++i)
+    while ((p = memchr(p, c, (size_t)(end - p))) != NULL)
     {
-        int c = getchar_ebuf(i);
+        ++n;
+        ++p;
+    }
+
+    return n;
+}
+
+
+///
+///  @brief    Count LFs in block that are not preceded by CRs, and which will
+///            therefore have CRs added when the page is written out.
+///
+///  @returns  No. of CRs to be added.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t count_lf(const char *p, uint_t nbytes, int last)
+{
+    assert(p != NULL);
+
+    const char *start = p;
+    const char *end   = p + nbytes;
+    uint_t n = 0;
 
-        if (c == EOF)
+    while ((p = memchr(p, LF, (size_t)(end - p))) != NULL)
+    {
+        if ((p == start ? last : p[-1]) != CR)
+        {
+            ++n;
+        }
+
+        ++p;
+    }
+
+    return n;
+}
+
+
+///
+///  @brief    Create page with data from edit buffer, and append it to the
+///            holding file. Note that if we're treating form feeds as a page
+///            delimiter, then we have to adjust the page count for any form
+///            feeds that the user may have added to the current page. This is
+///            to handle the situation where the user subsequently executes -P
+///            commands.
+///
+///  @returns  Descriptor for page we created.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static struct page make_page(int_t start, int_t end, bool ff)
+{
+    struct page_table *table = &ptable[ostream];
+
+    ++stats[STAT_PAGES_MADE];
+
+    if (table->fp == NULL && (table->fp = tmpfile()) == NULL)
+    {
+        throw(E_ERR, NULL);             // General error
+    }
+
+    if (fseek(table->fp, 0L, SEEK_END) != 0)
+    {
+        throw(E_ERR, NULL);             // General error
+    }
+
+    struct page page =
+    {
+        .offset = ftell(table->fp),
+        .size   = (uint_t)(end - start),
+        .cr     = 0,
+        .CR_out = f.e3.CR_out,
+        .ff     = ff,
+    };
+
+    // Write the text in as few pieces as possible (normally no more than two,
+    // one on each side of the gap in the edit buffer).
+
+    int last = NUL;
+
+    for (int_t i = start; i < end; )
+    {
+        uint_t nbytes = (uint_t)(end - i);
+        const char *p = getblock_ebuf(i, &nbytes);
+
+        if (p == NULL)
         {
             break;
         }
 
-        // Translate LF to CR/LF if needed, unless last chr. was CR
+        if (page.CR_out)
+        {
+            page.cr += count_lf(p, nbytes, last);
+        }
 
-        if (c == LF && last != CR && f.e3.CR_out)
+        if (ff)
         {
-            ++page.size;
+            table->count += (uint)count_chr(p, nbytes, FF);
         }
 
-        ++page.size;
+        if (fwrite(p, 1uL, (size_t)nbytes, table->fp) != (size_t)nbytes)
+        {
+            throw(E_ERR, NULL);         // General error
+        }
 
-        last = c;
+        last = p[nbytes - 1];
+        i   += (int_t)nbytes;
     }
 
-    if (ff)                             // Add a form feed if necessary
+    if (fflush(table->fp) != 0 || ferror(table->fp))
     {
-        ++page.size;
+        throw(E_ERR, NULL);             // General error
     }
 
-    // Second pass - fill page and then output it
+    return page;
+}
 
-    page.addr = alloc_mem((uint_t)page.size); // Allocate memory for page
 
-    char *p = page.addr;
+///
+///  @brief    Read in previous page.
+///
+///  @returns  true if we have a new page, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
 
-    for (int i = start; i < end; ++i)
+bool page_backward(int_t count, bool ff)
+{
+    assert(count < 0);
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    struct page_table *table = &ptable[ostream];
+    struct page page;
+
+    // Create a new page with data from edit buffer and push it on the stack.
+
+    if (t.Z != 0)
     {
-        int c = getchar_ebuf(i);
+        setpos_ebuf(t.B);
+
+        page = make_page(t.B, t.Z, ff);
+
+        kill_ebuf();
+
+        add_page(&table->stack, &page);
+    }
 
-        if (c == EOF)
+    // Now move pages from the end of the list to the stack, until we find the
+    // one we want (which will then be popped off the stack). Only the page
+    // descriptors move; the page data stays where it is in the holding file.
+
+    for (int_t n = count; n++ < 0; )
+    {
+        if (!remove_page(&table->list, &page))
         {
             break;
         }
 
-        // Translate LF to CR/LF if needed, unless last chr. was CR
+        add_page(&table->stack, &page);
+
+        if (n == 0)
+        {
+            (void)pop_page();
+
+            table->count -= (uint)-count;
+
+            return true;
+        }
+    }
+
+    table->count = 0;
+
+    return f.ctrl_e = false;
+}
+
+
+///
+///  @brief    Get page count for current page.
+///
+///  @returns  Page number (0 if no data in buffer).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint page_count(void)
+{
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    return ptable[ostream].count;
+}
+
+
+///
+///  @brief    Flush out remaining pages, and then delete holding file.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void page_flush(FILE *fp)
+{
+    assert(fp != NULL);                 // Error if no file block
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    struct page_table *table = &ptable[ostream];
+
+    // Write out all pages in list, followed by all pages on stack.
+
+    for (uint_t i = 0; i < table->list.count; ++i)
+    {
+        write_page(fp, &table->list.page[i]);
+    }
+
+    for (uint_t i = table->stack.count; i-- > 0; )
+    {
+        write_page(fp, &table->stack.page[i]);
+    }
+
+    close_hold(ostream);
+
+    table->count = 0;
+}
+
+
+///
+///  @brief    Write out current page.
+///
+///  @returns  true if already have buffer data, false if not.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool page_forward(FILE *unused1, int_t start, int_t end, bool ff, bool unused2)
+{
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    if (start != end || ff)             // Empty pages count if they have FFs
+    {
+        struct page page = make_page(start, end, ff);
+
+        add_page(&ptable[ostream].list, &page);
+    }
+
+    ++ptable[ostream].count;
+
+    return pop_page();
+}
+
+
+///
+///  @brief    Go directly to specified page, if it has been stored. If not,
+///            go to the last stored page, and let the caller read any more
+///            pages it needs. Only the page descriptors move; the data for
+///            intervening pages is not read from the holding file.
+///
+///  @returns  Page number for current page.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint page_seek(uint page, bool ff)
+{
+    assert(page != 0);
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    struct page_table *table = &ptable[ostream];
+
+    if (page < table->count)
+    {
+        (void)page_backward((int_t)page - (int_t)table->count, ff);
+
+        return table->count;
+    }
+    else if (page == table->count || table->stack.count == 0)
+    {
+        return table->count;
+    }
+
+    struct page current;
+
+    if (t.Z != 0)
+    {
+        setpos_ebuf(t.B);
+
+        current = make_page(t.B, t.Z, ff);
+
+        kill_ebuf();
+
+        add_page(&table->list, &current);
+    }
+
+    ++table->count;
+
+    while (table->count < page && table->stack.count > 1)
+    {
+        (void)remove_page(&table->stack, &current);
+
+        add_page(&table->list, &current);
+
+        ++table->count;
+    }
+
+    (void)pop_page();
+
+    return table->count;
+}
+
+
+///
+///  @brief    Pop page from stack, and copy to edit buffer.
+///
+///  @returns  true if there was a page on stack, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool pop_page(void)
+{
+    struct page page;
+
+    if (!remove_page(&ptable[ostream].stack, &page))
+    {
+        return false;
+    }
+
+    copy_page(&page);
 
-        if (c == LF && last != CR && f.e3.CR_out)
+    return true;
+}
+
+
+///
+///  @brief    Read data from holding file.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void read_hold(char *buf, long offset, uint_t nbytes)
+{
+    assert(buf != NULL);
+
+    FILE *fp = ptable[ostream].fp;
+
+    assert(fp != NULL);                 // Must have holding file if page
+
+    if (fseek(fp, offset, SEEK_SET) != 0
+        || fread(buf, 1uL, (size_t)nbytes, fp) != (size_t)nbytes)
+    {
+        throw(E_ERR, NULL);             // General error
+    }
+}
+
+
+///
+///  @brief    Remove page descriptor from end of array.
+///
+///  @returns  true if we got a page, false if array was empty.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool remove_page(struct page_list *list, struct page *page)
+{
+    assert(list != NULL);
+    assert(page != NULL);
+
+    if (list->count == 0)
+    {
+        return false;
+    }
+
+    *page = list->page[--list->count];
+
+    return true;
+}
+
+
+///
+///  @brief    Reset all pages (used by EK command).
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void reset_pages(uint stream)
+{
+    assert(stream == OFILE_PRIMARY || stream == OFILE_SECONDARY);
+
+    close_hold(stream);
+}
+
+
+///
+///  @brief    Set page count for current page.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void set_page(uint page)
+{
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    ptable[ostream].count = page;
+}
+
+
+///
+///  @brief    Copy page from holding file to output file, a block at a time,
+///            adding CRs before LFs if needed.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void write_page(FILE *fp, const struct page *page)
+{
+    assert(fp != NULL);
+    assert(page != NULL);
+
+    uint_t bufsize = (page->size < PAGE_BLOCK) ? page->size : PAGE_BLOCK;
+    char *buf      = (bufsize != 0) ? alloc_mem(bufsize) : NULL;
+    long offset    = page->offset;
+    uint_t left    = page->size;
+    char last      = NUL;
+
+    ++stats[STAT_PAGES_WRITTEN];
+
+    stats[STAT_WRITE + ostream] += page->size + page->cr + (page->ff ? 1 : 0);
+
+    while (left != 0)
+    {
+        uint_t nbytes = (left < bufsize) ? left : bufsize;
+        const char *run = buf;
+
+        read_hold(buf, offset, nbytes);
+
+        offset += (long)nbytes;
+        left   -= nbytes;
+
+        for (uint_t i = 0; i < nbytes; ++i)
         {
-            *p++ = CR;
+            char c = buf[i];
+
+            if (c == LF && last != CR && page->CR_out)
+            {
+                fwrite(run, (size_t)(buf + i - run), 1uL, fp);
+                fputc(CR, fp);
+
+                run = buf + i;
+            }
+
+            last = c;
         }
 
-        *p++ = (char)c;
+        fwrite(run, (size_t)(buf + nbytes - run), 1uL, fp);
     }
 
-    if (ff)                             // Add a form feed if necessary
+    if (page->ff)
     {
-        *p++ = FF;
+        fputc(FF, fp);
     }
 
-    assert((uint)(p - page.addr) == page.size); // Verify no. of output bytes
+    free_mem(&buf);
+}
 
-    fwrite(page.addr, (size_t)page.size, 1uL, fp);
 
-    free_mem(&page.addr);
+///
+///  @brief    Read in previous page, discarding current page.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void yank_backward(FILE *unused)
+{
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    struct page_table *table = &ptable[ostream];
+    struct page page;
+
+    if (!pop_page())
+    {
+        if (!remove_page(&table->list, &page))
+        {
+            kill_ebuf();
+        }
+        else
+        {
+            copy_page(&page);
+        }
+    }
+
+    if (table->count > 0)
+    {
+        --table->count;
+    }
 }
@@ -1,7 +1,7 @@
 ///
 ///  @file    page_std.c
-///  @brief   Standard paging functions (write pages to file immediately, no
-///           backwards paging allowed).
+///  @brief   Standard paging functions (write pages to file immediately, and
+///           keep only an index of pages written, for backwards paging).
 ///
 ///  @copyright 2019-2021 Franklin P. Johnston / Nowwith Treble Software
 ///
@@ -27,57 +27,744 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <unistd.h>
 
 #include "teco.h"
 #include "ascii.h"
 #include "editbuf.h"
 #include "eflags.h"
 #include "errcodes.h"
+#include "file.h"
 #include "page.h"
+#include "stats.h"
 #include "term.h"
 
-uint page_count = 0;                ///< Current page number
+
+#define PAGE_BLOCK  (KB * 64)           ///< Size of block for copying pages
+
+///  @struct   page
+///  @brief    Description of each page written to output file or holding file.
+
+struct page
+{
+    long offset;                        ///< Offset of page in file
+    uint_t size;                        ///< Size of page in bytes (w/o FF)
+    bool strip;                         ///< All CRs before LFs were added
+    bool ff;                            ///< Page ends with form feed
+};
+
+///  @struct   page_list
+///  @brief    Variable-length array of page descriptors.
+
+struct page_list
+{
+    struct page *page;                  ///< Array of page descriptors
+    uint_t count;                       ///< No. of pages in array
+    uint_t size;                        ///< No. of descriptors allocated
+};
+
+///  @struct   page_table
+///  @brief    Index of pages for output streams. Pages are written to the
+///            output file as usual, but we remember where each one starts, so
+///            that backwards paging can read a page back in. Any pages we back
+///            up over are moved from the output file to a holding file, and
+///            returned to the output file as we page forward again.
+
+struct page_table
+{
+    uint count;                         ///< Current page number
+    FILE *fp;                           ///< Output file that index refers to
+    long end;                           ///< End of output (-1 if no index)
+    FILE *hold;                         ///< Holding file for pages backed over
+    struct page_list list;              ///< Pages in output file
+    struct page_list stack;             ///< Pages in holding file
+};
+
+///  @var      ptable
+///  @brief    Stored data for primary and secondary output streams.
+
+static struct page_table ptable[] =
+{
+    { .count = 0, .fp = NULL, .end = 0, .hold = NULL },
+    { .count = 0, .fp = NULL, .end = 0, .hold = NULL },
+};
+
+// Local functions
+
+static void add_page(struct page_list *list, const struct page *page);
+
+static void close_hold(uint stream);
+
+static void copy_data(FILE *src, long offset, long nbytes, FILE *dst);
+
+static void hold_pages(uint_t first);
+
+static void index_page(uint_t nbytes, bool ff, bool strip);
+
+static void load_page(FILE *fp, const struct page *page);
+
+static bool pop_page(void);
+
+static bool remove_page(struct page_list *list, struct page *page);
+
+static void sync_pages(FILE *fp);
+
+static void trunc_output(long offset);
+
+static void unhold_page(void);
+
+static void write_page(FILE *fp, int_t start, int_t end, bool ff);
+
+
+///
+///  @brief    Add page descriptor to end of array.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void add_page(struct page_list *list, const struct page *page)
+{
+    assert(list != NULL);
+    assert(page != NULL);
+
+    if (list->count == list->size)      // Need to make array bigger?
+    {
+        uint_t size  = (uint_t)sizeof(*page);
+        uint_t delta = (list->size == 0) ? 16 : list->size;
+
+        if (list->page == NULL)
+        {
+            list->page = alloc_mem(delta * size);
+        }
+        else
+        {
+            list->page = expand_mem(list->page, list->size * size,
+                                    delta * size);
+        }
+
+        list->size += delta;
+    }
+
+    list->page[list->count++] = *page;
+}
+
+
+///
+///  @brief    Close holding file and discard all page descriptors for stream.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void close_hold(uint stream)
+{
+    struct page_table *table = &ptable[stream];
+
+    if (table->hold != NULL)
+    {
+        fclose(table->hold);            // Temp. file is deleted on close
+
+        table->hold = NULL;
+    }
+
+    free_mem(&table->list.page);
+    free_mem(&table->stack.page);
+
+    table->list.count  = table->list.size  = 0;
+    table->stack.count = table->stack.size = 0;
+}
+
+
+///
+///  @brief    Copy data from one file to the current position in another.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void copy_data(FILE *src, long offset, long nbytes, FILE *dst)
+{
+    assert(src != NULL);
+    assert(dst != NULL);
+
+    if (fseek(src, offset, SEEK_SET) != 0)
+    {
+        throw(E_ERR, NULL);             // General error
+    }
+
+    char *buf = alloc_mem((uint_t)PAGE_BLOCK);
+
+    while (nbytes > 0)
+    {
+        size_t n = (nbytes < PAGE_BLOCK) ? (size_t)nbytes : (size_t)PAGE_BLOCK;
+
+        if (fread(buf, 1uL, n, src) != n || fwrite(buf, 1uL, n, dst) != n)
+        {
+            free_mem(&buf);
+
+            throw(E_ERR, NULL);         // General error
+        }
+
+        nbytes -= (long)n;
+    }
+
+    free_mem(&buf);
+}
+
+
+///
+///  @brief    Move pages from the end of the output file to the holding file,
+///            starting with the specified page.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void hold_pages(uint_t first)
+{
+    struct page_table *table = &ptable[ostream];
+
+    if (first >= table->list.count)
+    {
+        return;
+    }
+
+    if (table->hold == NULL && (table->hold = tmpfile()) == NULL)
+    {
+        throw(E_ERR, NULL);             // General error
+    }
+
+    long base;
+
+    if (fseek(table->hold, 0L, SEEK_END) != 0
+        || (base = ftell(table->hold)) == -1)
+    {
+        throw(E_ERR, NULL);             // General error
+    }
+
+    long offset = table->list.page[first].offset;
+
+    copy_data(table->fp, offset, table->end - offset, table->hold);
+
+    // Push the pages on the stack in reverse order, so that the first page
+    // we moved is the next one to be popped.
+
+    while (table->list.count > first)
+    {
+        struct page page = table->list.page[--table->list.count];
+
+        page.offset += base - offset;
+
+        add_page(&table->stack, &page);
+
+        ++stats[STAT_PAGES_MADE];
+    }
+
+    trunc_output(offset);
+}
+
 
 ///
-///  @brief    Read in previous page (invalid for standard paging).
+///  @brief    Add page just written to index of pages in output file.
 ///
-///  @returns  Throws exception.
+///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-bool page_backward(int_t unused1, bool unused2)
+static void index_page(uint_t nbytes, bool ff, bool strip)
 {
-    throw(E_NPA);                       // P argument cannot be negative
+    struct page_table *table = &ptable[ostream];
+
+    if (table->end == -1)               // No index if file isn't seekable
+    {
+        return;
+    }
+
+    struct page page =
+    {
+        .offset = table->end,
+        .size   = nbytes,
+        .strip  = strip,
+        .ff     = ff,
+    };
+
+    add_page(&table->list, &page);
+
+    table->end += (long)nbytes + (ff ? 1 : 0);
 }
 
 
 ///
-///  @brief    Flush out remaining pages (no-op for standard paging).
+///  @brief    Read page from file into edit buffer. If we added CRs before all
+///            of the LFs when the page was written, then we remove them. If
+///            the page had some CR/LF sequences to begin with, then we keep
+///            all of the CRs, so that the page will be written out unchanged.
 ///
 ///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-void page_flush(FILE *unused)
+static void load_page(FILE *fp, const struct page *page)
 {
-    page_count = 0;
+    assert(fp != NULL);
+    assert(page != NULL);
+
+    ++stats[STAT_PAGES_COPIED];
+
+    kill_ebuf();
+
+    if (fseek(fp, page->offset, SEEK_SET) != 0)
+    {
+        throw(E_ERR, NULL);             // General error
+    }
+
+    bool strip    = page->strip;
+    bool cr       = false;
+    uint_t nbytes = page->size;
+    char *buf     = alloc_mem((uint_t)PAGE_BLOCK);
+
+    while (nbytes != 0)
+    {
+        size_t n = (nbytes < PAGE_BLOCK) ? (size_t)nbytes : (size_t)PAGE_BLOCK;
+
+        if (fread(buf, 1uL, n, fp) != n)
+        {
+            free_mem(&buf);
+
+            throw(E_ERR, NULL);         // General error
+        }
+
+        nbytes -= (uint_t)n;
+
+        // Since this data originated in the edit buffer, we assume it will
+        // fit, and therefore don't bother to check for warnings or errors.
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            int c = buf[i];
+
+            if (cr)
+            {
+                cr = false;
+
+                if (c != LF)
+                {
+                    (void)add_ebuf(CR);
+                }
+            }
+
+            if (c == CR && strip)
+            {
+                cr = true;
+            }
+            else
+            {
+                (void)add_ebuf(c);
+            }
+        }
+    }
+
+    if (cr)
+    {
+        (void)add_ebuf(CR);
+    }
+
+    free_mem(&buf);
+
+    f.ctrl_e = page->ff;
+
+    setpos_ebuf(t.B);                   // Reset to start of buffer
+}
+
+
+///
+///  @brief    Read in previous page.
+///
+///  @returns  true if we have a new page, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+bool page_backward(int_t count, bool ff)
+{
+    assert(count < 0);
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    struct page_table *table = &ptable[ostream];
+    FILE *fp = ofiles[ostream].fp;
+
+    if (fp == NULL)
+    {
+        throw(E_NFO);                   // No file for output
+    }
+
+    sync_pages(fp);
+
+    if (table->end == -1)               // Can't page back if not seekable
+    {
+        throw(E_NPA);                   // P argument cannot be negative
+    }
+
+    // Write out the edit buffer, then move pages to the holding file, until
+    // we find the one we want (which will then be popped off the stack).
+
+    bool stored = false;
+
+    if (t.Z != 0)
+    {
+        write_page(fp, t.B - t.dot, t.Z - t.dot, ff);
+        kill_ebuf();
+
+        stored = true;
+    }
+
+    int_t first = (int_t)table->list.count + count - (stored ? 1 : 0);
+
+    if (first >= 0)
+    {
+        hold_pages((uint_t)first);
+
+        (void)pop_page();
+
+        table->count = (uint)table->list.count + 1;
+
+        return true;
+    }
+
+    hold_pages((uint_t)0);
+
+    table->count = 0;
+
+    return f.ctrl_e = false;
+}
+
+
+///
+///  @brief    Get page count for current page.
+///
+///  @returns  Page number (0 if no data in buffer).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint page_count(void)
+{
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    return ptable[ostream].count;
+}
+
+
+///
+///  @brief    Flush out remaining pages. Any pages in the holding file are
+///            written to the output file.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void page_flush(FILE *fp)
+{
+    assert(fp != NULL);                 // Error if no file block
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    sync_pages(fp);
+
+    while (ptable[ostream].stack.count != 0)
+    {
+        unhold_page();
+    }
+
+    close_hold(ostream);
+
+    ptable[ostream].count = 0;
 }
 
 
 ///
 ///  @brief    Write out current page.
 ///
-///  @returns  false (edit buffer does not already have data).
+///  @returns  true if we have a new page from the holding file, false if the
+///            next page must be read from the input file.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-bool page_forward(FILE *fp, int_t start, int_t end, bool ff)
+bool page_forward(FILE *fp, int_t start, int_t end, bool ff, bool unused)
 {
     assert(fp != NULL);                 // Error if no file block
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    struct page_table *table = &ptable[ostream];
+
+    sync_pages(fp);
+    write_page(fp, start, end, ff);
+
+    bool havedata = pop_page();
+
+    if (table->end == -1)
+    {
+        ++table->count;
+    }
+    else
+    {
+        table->count = (uint)table->list.count + 1;
+    }
+
+    return havedata;
+}
 
-    int last = NUL;
 
-    // First pass - calculate how many characters we'll need to output
+///
+///  @brief    Go directly to specified page, if it has been written. If not,
+///            go as far as we can, and let the caller read any more pages it
+///            needs from the input file.
+///
+///  @returns  Page number for current page.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+uint page_seek(uint page, bool ff)
+{
+    assert(page != 0);
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    struct page_table *table = &ptable[ostream];
+    FILE *fp = ofiles[ostream].fp;
+
+    if (page < table->count)
+    {
+        (void)page_backward((int_t)page - (int_t)table->count, ff);
+
+        return table->count;
+    }
+
+    assert(fp != NULL);                 // Error if no file block
+
+    sync_pages(fp);
+
+    if (page == table->count || table->stack.count == 0)
+    {
+        return table->count;
+    }
+
+    // Write out the edit buffer, and copy pages from the holding file back to
+    // the output file without reading them, until we get to the one we want.
+
+    if (t.Z != 0)
+    {
+        write_page(fp, t.B - t.dot, t.Z - t.dot, ff);
+        kill_ebuf();
+    }
+
+    while (table->list.count + 1 < page && table->stack.count > 1)
+    {
+        unhold_page();
+    }
+
+    (void)pop_page();
+
+    table->count = (uint)table->list.count + 1;
+
+    return table->count;
+}
+
+
+///
+///  @brief    Pop page from stack, and read it from holding file into edit
+///            buffer.
+///
+///  @returns  true if there was a page on stack, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool pop_page(void)
+{
+    struct page_table *table = &ptable[ostream];
+    struct page page;
+
+    if (!remove_page(&table->stack, &page))
+    {
+        return false;
+    }
+
+    load_page(table->hold, &page);
+
+    if (table->stack.count == 0)        // Discard holding file when empty
+    {
+        fclose(table->hold);
+
+        table->hold = NULL;
+    }
+
+    return true;
+}
+
+
+///
+///  @brief    Remove page descriptor from end of array.
+///
+///  @returns  true if page removed, false if array was empty.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool remove_page(struct page_list *list, struct page *page)
+{
+    assert(list != NULL);
+    assert(page != NULL);
+
+    if (list->count == 0)
+    {
+        return false;
+    }
+
+    *page = list->page[--list->count];
+
+    return true;
+}
+
+
+///
+///  @brief    Reset all pages (used by EK command).
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void reset_pages(uint stream)
+{
+    assert(stream == OFILE_PRIMARY || stream == OFILE_SECONDARY);
+
+    close_hold(stream);
+
+    ptable[stream].fp  = NULL;
+    ptable[stream].end = 0;
+}
+
+
+///
+///  @brief    Set page count for current page.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void set_page(uint page)
+{
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    ptable[ostream].count = page;
+}
+
+
+///
+///  @brief    Make sure that page index is for the current output file. If
+///            the file was changed, or was written to elsewhere, then the old
+///            index (and any pages in the holding file) are discarded.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void sync_pages(FILE *fp)
+{
+    assert(fp != NULL);
+
+    struct page_table *table = &ptable[ostream];
+    long end = ftell(fp);
+
+    if (fp != table->fp || end != table->end)
+    {
+        close_hold(ostream);
+
+        table->fp  = fp;
+        table->end = end;               // -1 if file isn't seekable
+    }
+}
+
+
+///
+///  @brief    Truncate output file at start of page.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void trunc_output(long offset)
+{
+    struct page_table *table = &ptable[ostream];
+
+    if (fseek(table->fp, offset, SEEK_SET) != 0
+        || ftruncate(fileno(table->fp), (off_t)offset) != 0)
+    {
+        throw(E_ERR, NULL);             // General error
+    }
+
+    table->end = offset;
+}
+
+
+///
+///  @brief    Copy next page in holding file back to output file, without
+///            reading it into the edit buffer.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void unhold_page(void)
+{
+    struct page_table *table = &ptable[ostream];
+    struct page page;
+
+    if (!remove_page(&table->stack, &page))
+    {
+        return;
+    }
+
+    long nbytes = (long)page.size + (page.ff ? 1 : 0);
+
+    if (fseek(table->fp, table->end, SEEK_SET) != 0)
+    {
+        throw(E_ERR, NULL);             // General error
+    }
+
+    copy_data(table->hold, page.offset, nbytes, table->fp);
+
+    ++stats[STAT_PAGES_WRITTEN];
+
+    stats[STAT_WRITE + ostream] += (uint_t)nbytes;
+
+    page.offset = table->end;
+    table->end += nbytes;
+
+    add_page(&table->list, &page);
+
+    if (table->stack.count == 0)        // Discard holding file when empty
+    {
+        fclose(table->hold);
+
+        table->hold = NULL;
+    }
+}
+
+
+///
+///  @brief    Write data from edit buffer to output file, and add it to the
+///            page index. If we're treating form feeds as page delimiters,
+///            then any form feeds that the user may have added start new
+///            pages.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void write_page(FILE *fp, int_t start, int_t end, bool ff)
+{
+    assert(fp != NULL);                 // Error if no file block
+
+    uint_t nbytes = 0;
+    uint_t total = 0;                   // Total bytes written
+    bool strip = f.e3.CR_out;
+    int last = NUL;
 
     for (int_t i = start; i < end; ++i)
     {
@@ -90,48 +777,94 @@ bool page_forward(FILE *fp, int_t start, int_t end, bool ff)
 
         // Translate LF to CR/LF if needed, unless last chr. was CR
 
-        if (c == LF && last != CR && f.e3.CR_out)
+        if (c == LF && f.e3.CR_out)
         {
-            fputc(CR, fp);
+            if (last != CR)
+            {
+                fputc(CR, fp);
+
+                ++nbytes;
+                ++total;
+            }
+            else
+            {
+                strip = false;          // Page already had CR/LF
+            }
         }
 
         fputc(c, fp);
 
+        ++total;
+
+        if (c == FF && !f.e3.nopage)
+        {
+            index_page(nbytes, (bool)true, strip);
+
+            nbytes = 0;
+            strip  = f.e3.CR_out;
+        }
+        else
+        {
+            ++nbytes;
+        }
+
         last = c;
     }
 
     if (ff)                             // Add a form feed if necessary
     {
         fputc(FF, fp);
+
+        ++total;
     }
 
-    ++page_count;
+    ++stats[STAT_PAGES_WRITTEN];
+
+    stats[STAT_WRITE + ostream] += total;
 
-    return false;
+    if (nbytes != 0 || ff)
+    {
+        index_page(nbytes, ff, strip);
+    }
 }
 
 
 ///
-///  @brief    Reset all pages (no-op for standard paging).
+///  @brief    Read in previous page, discarding current page.
 ///
 ///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-void reset_pages(void)
+void yank_backward(FILE *unused)
 {
-}
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
 
+    struct page_table *table = &ptable[ostream];
+    FILE *fp = ofiles[ostream].fp;
+    struct page page;
 
-///
-///  @brief    Read in previous page, discarding current page (invalid for
-///            standard paging).
-///
-///  @returns  Throws exception.
-///
-////////////////////////////////////////////////////////////////////////////////
+    if (fp != NULL)
+    {
+        sync_pages(fp);
 
-void yank_backward(FILE *unused)
-{
-    throw(E_NYA);                       // Numeric argument with Y
+        if (table->end == -1)           // Can't page back if not seekable
+        {
+            throw(E_NYA);               // Numeric argument with Y
+        }
+    }
+
+    kill_ebuf();
+
+    if (fp == NULL || !remove_page(&table->list, &page))
+    {
+        table->count = 0;
+
+        return;
+    }
+
+    load_page(fp, &page);
+    trunc_output(page.offset);
+
+    table->count = (uint)table->list.count + 1;
 }
@@ -25,7 +25,9 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include <assert.h>
+#include <errno.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -33,34 +35,47 @@
 #include "ascii.h"
 #include "editbuf.h"
 #include "eflags.h"
+#include "errcodes.h"
 #include "file.h"
 #include "page.h"
+#include "stats.h"
 #include "term.h"
 
 
+#define PACK_MIN    (KB * 4)        ///< Don't compress pages smaller than this
+#define PACK_HASH   12              ///< No. of bits in match hash
+#define PACK_MATCH  4               ///< Minimum match length
+#define PACK_LAST   5               ///< Block always ends with 5 literals
+#define PACK_LIMIT  12              ///< No match may start this close to end
+#define SLOT_MIN    64              ///< Initial no. of slots in page table
+
 ///  @struct   page
 ///  @brief    Description of each page stored internally.
 
 struct page
 {
-    struct page *next;                  ///< Next page in queue
-    struct page *prev;                  ///< Previous page in queue
     char *addr;                         ///< Address of page
     uint_t size;                        ///< Size of page in bytes
+    uint_t packed;                      ///< Compressed size (0 if none)
     uint_t cr;                          ///< No. of added CRs in page
     bool CR_out;                        ///< Copy of f.e3.CR_out
     bool ff;                            ///< Append form feed to page
 };
 
 ///  @struct   page_table
-///  @brief    Description of stored pages for output streams.
+///  @brief    Description of stored pages for output streams. Pages are kept
+///            in an array in page order, so that we can go directly to any
+///            page. The slot for the page that is in the edit buffer is NULL,
+///            unless it is past the last slot in the table (as happens when
+///            a page is read from the input file).
 
 struct page_table
 {
     uint count;                         ///< Current page number
-    struct page *head;                  ///< Head of page list
-    struct page *tail;                  ///< Tail of page list
-    struct page *stack;                 ///< Saved page stack
+    struct page **page;                 ///< Array of stored pages
+    uint_t npages;                      ///< No. of slots in use
+    uint_t size;                        ///< No. of slots allocated
+    uint_t current;                     ///< Slot for current page
 };
 
 ///  @var      ptable
@@ -68,29 +83,47 @@ struct page_table
 
 static struct page_table ptable[] =
 {
-    { .count = 0, .head = NULL, .tail = NULL, .stack = NULL },
-    { .count = 0, .head = NULL, .tail = NULL, .stack = NULL },
+    { .count = 0, .page = NULL, .npages = 0, .size = 0, .current = 0 },
+    { .count = 0, .page = NULL, .npages = 0, .size = 0, .current = 0 },
 };
 
 // Local functions
 
 static void copy_page(struct page *page);
 
-static void link_page(struct page *page);
+static void count_cr(struct page *page);
+
+static bool get_page(uint_t slot);
+
+static void insert_slot(uint_t slot);
+
+static struct page *make_page(int_t start, int_t end, bool ff, bool detach);
+
+static uint_t pack_data(const uchar *src, uint_t len, uchar *dst, uint_t max);
+
+static void pack_page(struct page *page);
 
-static struct page *make_page(int_t start, int_t end, bool ff);
+static uint_t page_bytes(const struct page *page);
 
-static bool pop_page(void);
+static uchar *put_length(uchar *p, uint_t len);
 
-static void push_page(struct page *page);
+static void put_page(struct page *page);
 
-static struct page *unlink_page(void);
+static void remove_slot(uint_t slot);
+
+static struct page *split_page(struct page *page);
+
+static bool unpack_data(const uchar *src, uint_t len, uchar *dst, uint_t size);
+
+static void unpack_page(struct page *page);
 
 static void write_page(FILE *fp, struct page *page);
 
 
 ///
-///  @brief    Copy data in page to edit buffer, and then delete it.
+///  @brief    Copy data in page to edit buffer, and then delete it. The page
+///            block itself becomes the new edit buffer, so that no data needs
+///            to be copied.
 ///
 ///  @returns  Nothing.
 ///
@@ -100,134 +133,340 @@ static void copy_page(struct page *page)
 {
     assert(page != NULL);
 
-    kill_ebuf();                        // Delete all data in edit buffer
+    unpack_page(page);
 
-    // If there is a form feed in the page (because the user added it while
-    // editing), then we have to treat it as an end of page marker, and only
-    // return the data after the form feed. We also reduce the count for the
-    // current page and add it back onto the list.
+    ++stats[STAT_PAGES_COPIED];
 
-    bool split = false;                 // true if we split the page
-    uint_t nbytes = page->size;         // No. of bytes to copy to edit buffer
-    char *p;
+    track_mem(MEM_PAGE, page_bytes(page), (uint_t)0);
 
-    if (!f.e3.nopage && (p = strrchr(page->addr, '\f')) != NULL)
-    {
-        split       = true;
-        *p++        = NUL;              // Make sure we don't match next time
-        nbytes     -= (uint)(p - page->addr);
-        page->size -= nbytes + 1;
-        page->ff    = true;
-    }
-    else
-    {
-        p = page->addr;
-    }
+    f.ctrl_e = page->ff;
+
+    attach_ebuf(page->addr, page->size, page->size + 1);
+
+    page->addr = NULL;                  // Edit buffer now owns page data
+
+    free_mem(&page);
+}
+
+
+///
+///  @brief    Count the CRs we'll need to add to page on output.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void count_cr(struct page *page)
+{
+    assert(page != NULL);
 
-    // Copy page data to edit buffer. Since this data originated in the edit
-    // buffer, we assume it will fit, and therefore don't bother to check for
-    // warnings or errors.
+    page->cr = 0;
 
-    while (nbytes-- != 0)
+    if (page->CR_out)
     {
-        (void)add_ebuf(*p++);
+        const char *p = page->addr;
+        char last = NUL;
+
+        for (uint_t i = 0; i < page->size; ++i)
+        {
+            char c = *p++;
+
+            if (c == LF && last != CR)
+            {
+                ++page->cr;
+            }
+
+            last = c;
+        }
     }
+}
 
-    setpos_ebuf(t.B);                   // Reset to start of buffer
 
-    if (split)
+///
+///  @brief    Copy page in specified slot to edit buffer, and make it the
+///            current page.
+///
+///  @returns  true if we have a new page, false if slot is past end of table.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool get_page(uint_t slot)
+{
+    struct page_table *table = &ptable[ostream];
+
+    if (slot >= table->npages)
     {
-        link_page(page);
+        return false;
     }
-    else
-    {
-        f.ctrl_e = page->ff;
 
-        free_mem(&page->addr);
-        free_mem(&page);
-    }
+    struct page *page = table->page[slot];
+
+    assert(page != NULL);               // Error if slot already in use
+
+    table->page[slot] = NULL;
+    table->current    = slot;
+    table->count      = (uint)slot + 1;
+
+    copy_page(page);
+
+    return true;
 }
 
 
 ///
-///  @brief    Add page to tail of linked list.
+///  @brief    Insert empty slot in page table.
 ///
 ///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-static void link_page(struct page *page)
+static void insert_slot(uint_t slot)
 {
-    assert(page != NULL);
+    struct page_table *table = &ptable[ostream];
 
-    if (ptable[ostream].head == NULL)
-    {
-        ptable[ostream].head = page;       // Head -> new page
-    }
-    else
+    assert(slot <= table->npages);
+
+    if (table->npages == table->size)
     {
-        page->prev = ptable[ostream].tail; // New page -> last page
-        ptable[ostream].tail->next = page; // Last page -> new page
+        uint_t size   = table->size ? table->size * 2 : SLOT_MIN;
+        uint_t nbytes = (uint_t)sizeof(*table->page);
+
+        if (table->page == NULL)
+        {
+            table->page = alloc_mem(size * nbytes);
+        }
+        else
+        {
+            table->page = expand_mem(table->page, table->size * nbytes,
+                                     size * nbytes);
+        }
+
+        table->size = size;
     }
 
-    ptable[ostream].tail = page;           // Tail -> new page
+    memmove(table->page + slot + 1, table->page + slot,
+            (size_t)(table->npages - slot) * sizeof(*table->page));
+
+    table->page[slot] = NULL;
+
+    ++table->npages;
 }
 
 
 ///
-///  @brief    Create page with data from edit buffer. Note that if we're
-///            treating form feeds as a page delimiter, then we have to adjust
-///            the page count for any form feeds that the user may have added
-///            to the current page. This is to handle the situation where the
-///            user subsequently executes -P commands.
+///  @brief    Create page with data from edit buffer. If the edit buffer is
+///            about to be discarded, then we detach its data instead of
+///            copying it.
 ///
 ///  @returns  Pointer to page we created.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-static struct page *make_page(int_t start, int_t end, bool ff)
+static struct page *make_page(int_t start, int_t end, bool ff, bool detach)
 {
     struct page *page = alloc_mem((uint_t)sizeof(*page));
 
-    page->next   = page->prev = NULL;
+    ++stats[STAT_PAGES_MADE];
+
     page->size   = (uint)(end - start);
+    page->packed = 0;
     page->cr     = 0;
     page->CR_out = f.e3.CR_out;
     page->ff     = ff;
-    page->addr   = alloc_mem(page->size);
 
-    char *p  = page->addr;
-    char last = NUL;
+    if (detach)                         // Can we take the entire buffer?
+    {
+        assert(start == t.B - t.dot && end == t.Z - t.dot);
 
-    for (int_t i = start; i < end; ++i)
+        page->addr = detach_ebuf();
+    }
+    else
     {
-        int c = getchar_ebuf(i);
+        page->addr = alloc_mem(page->size + 1); // Allow for trailing NUL
+
+        char *p = page->addr;
 
-        if (c == EOF)
+        // Copy the text in as few pieces as possible (normally no more than
+        // two, one on each side of the gap in the edit buffer).
+
+        for (int_t i = start; i < end; )
         {
-            break;
+            uint_t nbytes = (uint_t)(end - i);
+            const char *src = getblock_ebuf(i, &nbytes);
+
+            if (src == NULL)
+            {
+                break;
+            }
+
+            memcpy(p, src, (size_t)nbytes);
+
+            p += nbytes;
+            i += (int_t)nbytes;
         }
 
-        if (c == LF && last != CR && page->CR_out)
+        assert(p - page->addr == (ptrdiff_t)page->size);
+    }
+
+    track_mem(MEM_PAGE, (uint_t)0, page_bytes(page));
+
+    return page;
+}
+
+
+///
+///  @brief    Compress block of data, using a byte-oriented LZ77 format which
+///            is the same as an LZ4 block. Each sequence consists of a token
+///            byte (with literal and match lengths in the high and low four
+///            bits), any extra literal length bytes, the literals, a two-byte
+///            match offset, and any extra match length bytes. The last
+///            sequence has only literals.
+///
+///  @returns  Size of compressed data, or 0 if it would not be smaller than
+///            the maximum size specified.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t pack_data(const uchar *src, uint_t len, uchar *dst, uint_t max)
+{
+    assert(src != NULL);
+    assert(dst != NULL);
+
+    uint_t table[1u << PACK_HASH];      // Last position of each hashed sequence
+    uchar *p      = dst;
+    uchar *end    = dst + max;
+    uint_t anchor = 0;                  // Start of pending literals
+    uint_t pos    = 0;
+
+    memset(table, 0, sizeof(table));
+
+    while (len >= PACK_LIMIT && pos < len - PACK_LIMIT)
+    {
+        uint32_t seq;
+
+        memcpy(&seq, src + pos, sizeof(seq));
+
+        uint hash = (uint)((seq * 2654435761u) >> (32 - PACK_HASH));
+        uint_t ref = table[hash];
+
+        table[hash] = pos;
+
+        if (ref >= pos || pos - ref > UINT16_MAX
+            || memcmp(src + ref, src + pos, (size_t)PACK_MATCH) != 0)
+        {
+            ++pos;
+
+            continue;
+        }
+
+        uint_t nmatch = PACK_MATCH;
+        uint_t maxmatch = len - PACK_LAST - pos;
+
+        while (nmatch < maxmatch && src[ref + nmatch] == src[pos + nmatch])
+        {
+            ++nmatch;
+        }
+
+        uint_t nlit = pos - anchor;
+        uint_t offset = pos - ref;
+
+        uint_t need = 1 + nlit + nlit / 255 + 1 + 2 + nmatch / 255 + 1;
+
+        if ((uint_t)(end - p) <= need)
+        {
+            return 0;                   // Compressed data is too big
+        }
+
+        uchar *token = p++;
+
+        *token = (uchar)(((nlit < 15) ? nlit : 15) << 4);
+
+        if (nlit >= 15)
         {
-            ++page->cr;
+            p = put_length(p, nlit - 15);
         }
-        else if (ff && c == FF)
+
+        memcpy(p, src + anchor, (size_t)nlit);
+
+        p += nlit;
+        *p++ = (uchar)offset;
+        *p++ = (uchar)(offset >> 8);
+
+        nmatch -= PACK_MATCH;
+        *token |= (uchar)((nmatch < 15) ? nmatch : 15);
+
+        if (nmatch >= 15)
         {
-            ++ptable[ostream].count;
+            p = put_length(p, nmatch - 15);
         }
 
-        *p++ = last = (char)c;
+        pos = anchor = pos + nmatch + PACK_MATCH;
     }
 
-    assert(p - page->addr == (ptrdiff_t)page->size);
+    // Store any remaining data as literals.
 
-    return page;
+    uint_t nlit = len - anchor;
+
+    if ((uint_t)(end - p) <= 1 + nlit + nlit / 255 + 1)
+    {
+        return 0;                       // Compressed data is too big
+    }
+
+    *p++ = (uchar)(((nlit < 15) ? nlit : 15) << 4);
+
+    if (nlit >= 15)
+    {
+        p = put_length(p, nlit - 15);
+    }
+
+    memcpy(p, src + anchor, (size_t)nlit);
+
+    p += nlit;
+
+    return (uint_t)(p - dst);
+}
+
+
+///
+///  @brief    Compress page if page compression is enabled, and if page is big
+///            enough and compressible enough to make it worthwhile.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void pack_page(struct page *page)
+{
+    assert(page != NULL);
+
+    if (!f.e3.compress || page->packed != 0 || page->size < PACK_MIN)
+    {
+        return;
+    }
+
+    uint_t max    = page->size - page->size / 8; // Must save at least 1/8
+    uchar *data   = alloc_mem(max);
+    uint_t nbytes = pack_data((uchar *)page->addr, page->size, data, max);
+
+    if (nbytes == 0)
+    {
+        free_mem(&data);                // Not compressible, so keep page as is
+
+        return;
+    }
+
+    free_mem(&page->addr);
+
+    track_mem(MEM_PAGE, page_bytes(page), nbytes);
+
+    page->addr   = shrink_mem(data, max, max - nbytes);
+    page->packed = nbytes;
 }
 
 
 ///
-///  @brief    Read in previous page.
+///  @brief    Read in previous page. Since all pages are stored in the page
+///            table, we can go directly to the one we want.
 ///
 ///  @returns  true if we have a new page, else false.
 ///
@@ -238,52 +477,57 @@ bool page_backward(int_t count, bool ff)
     assert(count < 0);
     assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
 
-    // Create a new page with data from edit buffer and push it on the stack.
-
-    struct page *page;
+    struct page_table *table = &ptable[ostream];
+    struct page *page = NULL;
 
     if (t.Z != 0)
     {
         setpos_ebuf(t.B);
 
-        page = make_page(t.B, t.Z, ff);
+        page = make_page(t.B, t.Z, ff, (bool)true);
+    }
+
+    put_page(page);
+
+    // If we stored the edit buffer, then the page we want is relative to the
+    // last slot we used; if not, it's relative to the next one.
 
-        kill_ebuf();
+    int_t slot = (int_t)table->current + count - (page != NULL ? 1 : 0);
 
-        push_page(page);
+    if (slot >= 0 && get_page((uint_t)slot))
+    {
+        return true;
     }
 
-    // Now unlink pages from linked list and push them on the stack, until we
-    // find the one we want (which will then be popped off the stack).
+    // Here if we backed up past the first page, so the edit buffer is now
+    // empty, and is positioned before any stored pages.
 
-    while (count++ < 0)
+    if (table->npages != 0)
     {
-        if ((page = unlink_page()) == NULL)
-        {
-            break;
-        }
+        insert_slot((uint_t)0);
+    }
 
-        push_page(page);                // Then push it on stack
+    table->current = 0;
+    table->count   = 0;
 
-        if (count == 0)
-        {
-            bool havedata = pop_page();
+    return f.ctrl_e = false;
+}
 
-            if (havedata)
-            {
-                --ptable[ostream].count;
-            }
 
-            return havedata;
-        }
-    }
+///
+///  @brief    Get no. of bytes of data stored for page. This is only used to
+///            track memory usage, and the data of a page that has been split
+///            is treated as having been divided between the two pages.
+///
+///  @returns  No. of bytes.
+///
+////////////////////////////////////////////////////////////////////////////////
 
-    if (ptable[ostream].count > 0)
-    {
-        --ptable[ostream].count;
-    }
+static uint_t page_bytes(const struct page *page)
+{
+    assert(page != NULL);
 
-    return f.ctrl_e = false;
+    return (page->packed != 0) ? page->packed : page->size + 1;
 }
 
 
@@ -314,92 +558,214 @@ void page_flush(FILE *fp)
     assert(fp != NULL);                 // Error if no file block
     assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
 
-    struct page *page;
+    struct page_table *table = &ptable[ostream];
 
-    // Write out all pages in queue.
+    // Write out all stored pages, skipping the slot for the edit buffer.
 
-    while ((page = ptable[ostream].head) != NULL)
+    for (uint_t i = 0; i < table->npages; ++i)
     {
-        ptable[ostream].head = page->next;
-
-        write_page(fp, page);
+        if (table->page[i] != NULL)
+        {
+            write_page(fp, table->page[i]);
+        }
     }
 
-    ptable[ostream].tail = NULL;
+    free_mem(&table->page);
+
+    table->npages  = table->size = 0;
+    table->current = 0;
+    table->count   = 0;
+}
+
+
+///
+///  @brief    Write out current page.
+///
+///  @returns  true if already have buffer data, false if not.
+///
+////////////////////////////////////////////////////////////////////////////////
 
-    while ((page = ptable[ostream].stack) != NULL)
+bool page_forward(FILE *unused, int_t start, int_t end, bool ff, bool yank)
+{
+    assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
+
+    struct page_table *table = &ptable[ostream];
+    struct page *page = NULL;
+
+    if (start != end || ff)             // Empty pages count if they have FFs
     {
-        ptable[ostream].stack = page->next;
+        // We can take over the edit buffer if we're writing all of it, and
+        // if it's about to be replaced, either with the next stored page, or
+        // with the next page from the input file.
 
-        write_page(fp, page);
+        bool detach = (start == t.B - t.dot && end == t.Z - t.dot
+                       && (yank || table->current + 1 < table->npages));
+
+        page = make_page(start, end, ff, detach);
     }
 
-    ptable[ostream].count = 0;
+    put_page(page);
+
+    if (get_page(table->current))
+    {
+        return true;
+    }
+
+    table->count = (uint)table->current + 1;
+
+    return false;
 }
 
 
 ///
-///  @brief    Write out current page.
+///  @brief    Go directly to specified page, if it has been stored. If not,
+///            go to the last stored page, and let the caller read any more
+///            pages it needs.
 ///
-///  @returns  true if already have buffer data, false if not.
+///  @returns  Page number for current page.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-bool page_forward(FILE *unused, int_t start, int_t end, bool ff)
+uint page_seek(uint page, bool ff)
 {
+    assert(page != 0);
     assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
 
-    if (start != end)
+    struct page_table *table = &ptable[ostream];
+
+    if (page == table->count)
+    {
+        return page;
+    }
+
+    struct page *current = NULL;
+
+    if (t.Z != 0)
     {
-        struct page *page = make_page(start, end, ff);
+        setpos_ebuf(t.B);
 
-        link_page(page);
+        current = make_page(t.B, t.Z, ff, (bool)true);
     }
 
-    ++ptable[ostream].count;
+    put_page(current);
+
+    if (table->npages != 0)
+    {
+        uint_t slot = page - 1;
+
+        if (slot >= table->npages)
+        {
+            slot = table->npages - 1;
+        }
 
-    return pop_page();
+        (void)get_page(slot);
+    }
+
+    return table->count;
 }
 
 
 ///
-///  @brief    Pop page from stack, and copy to edit buffer.
+///  @brief    Store extra length bytes for literal or match.
 ///
-///  @returns  true if there was a page on stack, else false.
+///  @returns  Updated output pointer.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-static bool pop_page(void)
+static uchar *put_length(uchar *p, uint_t len)
 {
-    struct page *page = ptable[ostream].stack;
+    assert(p != NULL);
 
-    if (page == NULL)
+    while (len >= 255)
     {
-        return false;
+        *p++ = 255;
+        len -= 255;
     }
 
-    ptable[ostream].stack = page->next;
+    *p++ = (uchar)len;
 
-    copy_page(page);
+    return p;
+}
 
-    return true;
+
+///
+///  @brief    Store page from edit buffer in the current slot (or a new slot
+///            if we are past the end of the table). If we're treating form
+///            feeds as page delimiters, then any form feeds that the user may
+///            have added start new pages. On return, the current slot is the
+///            one following the page(s) stored.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void put_page(struct page *page)
+{
+    struct page_table *table = &ptable[ostream];
+
+    if (page == NULL)                   // Nothing in edit buffer?
+    {
+        if (table->current < table->npages)
+        {
+            remove_slot(table->current);
+        }
+
+        return;
+    }
+
+    if (table->current == table->npages)
+    {
+        insert_slot(table->current);
+    }
+
+    assert(table->page[table->current] == NULL);
+
+    table->page[table->current] = page;
+
+    uint_t last = table->current;
+
+    if (!f.e3.nopage)
+    {
+        struct page *next;
+
+        while ((next = split_page(page)) != NULL)
+        {
+            insert_slot(table->current + 1);
+
+            table->page[table->current + 1] = next;
+
+            ++last;
+        }
+    }
+
+    while (table->current <= last)
+    {
+        page = table->page[table->current++];
+
+        count_cr(page);
+        pack_page(page);
+    }
 }
 
 
 ///
-///  @brief    Push page onto stack.
+///  @brief    Remove slot from page table.
 ///
 ///  @returns  Nothing.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-static void push_page(struct page *page)
+static void remove_slot(uint_t slot)
 {
-    assert(page != NULL);
+    struct page_table *table = &ptable[ostream];
+
+    assert(slot < table->npages);
+    assert(table->page[slot] == NULL);
 
-    page->next = ptable[ostream].stack;
+    --table->npages;
 
-    ptable[ostream].stack = page;
+    memmove(table->page + slot, table->page + slot + 1,
+            (size_t)(table->npages - slot) * sizeof(*table->page));
 }
 
 
@@ -414,17 +780,25 @@ void reset_pages(uint stream)
 {
     assert(stream == OFILE_PRIMARY || stream == OFILE_SECONDARY);
 
-    struct page *page;
+    struct page_table *table = &ptable[stream];
 
-    while ((page = ptable[stream].head) != NULL)
+    for (uint_t i = 0; i < table->npages; ++i)
     {
-        ptable[stream].head = page->next;
+        struct page *page = table->page[i];
 
-        free_mem(&page->addr);
-        free_mem(&page);
+        if (page != NULL)
+        {
+            track_mem(MEM_PAGE, page_bytes(page), (uint_t)0);
+
+            free_mem(&page->addr);
+            free_mem(&page);
+        }
     }
 
-    ptable[stream].tail = NULL;
+    free_mem(&table->page);
+
+    table->npages  = table->size = 0;
+    table->current = 0;
 }
 
 
@@ -444,38 +818,187 @@ void set_page(uint page)
 
 
 ///
-///  @brief    Unlink page from end of linked list.
+///  @brief    Split page at the last form feed in it (which the user must have
+///            added while editing).
 ///
-///  @returns  Returned page, or NULL if list is empty.
+///  @returns  New page with data following form feed, or NULL if no form feed.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-static struct page *unlink_page(void)
+static struct page *split_page(struct page *page)
 {
-    struct page *page;
+    assert(page != NULL);
+    assert(page->packed == 0);
+
+    uint_t pos = page->size;
+
+    while (pos != 0 && page->addr[pos - 1] != FF)
+    {
+        --pos;
+    }
 
-    if ((page = ptable[ostream].tail) == NULL)
+    if (pos == 0)
     {
         return NULL;
     }
 
-    assert(page->next == NULL);
+    char *p = page->addr + pos - 1;
+
+    struct page *next = alloc_mem((uint_t)sizeof(*next));
+
+    *p++ = NUL;
+
+    next->size   = page->size - (uint_t)(p - page->addr);
+    next->addr   = alloc_mem(next->size + 1);
+    next->packed = 0;
+    next->cr     = 0;
+    next->CR_out = page->CR_out;
+    next->ff     = page->ff;
+
+    memcpy(next->addr, p, (size_t)next->size);
+
+    page->size -= next->size + 1;
+    page->ff    = true;
+
+    return next;
+}
+
+
+///
+///  @brief    Uncompress block of data created by pack_data().
+///
+///  @returns  true if data was uncompressed to exactly the size expected,
+///            else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool unpack_data(const uchar *src, uint_t len, uchar *dst, uint_t size)
+{
+    assert(src != NULL);
+    assert(dst != NULL);
+
+    const uchar *end = src + len;
+    uchar *p = dst;
+
+    while (src < end)
+    {
+        uint token = *src++;
+        uint_t nlit = token >> 4;
+        uint c;
+
+        if (nlit == 15)
+        {
+            do
+            {
+                if (src == end)
+                {
+                    return false;
+                }
+
+                nlit += c = *src++;
+            } while (c == 255);
+        }
+
+        if (nlit > (uint_t)(end - src) || nlit > size - (uint_t)(p - dst))
+        {
+            return false;
+        }
+
+        memcpy(p, src, (size_t)nlit);
+
+        p   += nlit;
+        src += nlit;
+
+        if (src == end)                 // Last sequence has no match
+        {
+            break;
+        }
+        else if (end - src < 2)
+        {
+            return false;
+        }
+
+        uint_t offset = (uint_t)src[0] | (uint_t)src[1] << 8;
+        uint_t nmatch = token & 15;
+
+        src += 2;
+
+        if (nmatch == 15)
+        {
+            do
+            {
+                if (src == end)
+                {
+                    return false;
+                }
+
+                nmatch += c = *src++;
+            } while (c == 255);
+        }
+
+        nmatch += PACK_MATCH;
+
+        if (offset == 0 || offset > (uint_t)(p - dst)
+            || nmatch > size - (uint_t)(p - dst))
+        {
+            return false;
+        }
+
+        const uchar *ref = p - offset;
+
+        if (offset >= nmatch)           // Can we copy it all at once?
+        {
+            memcpy(p, ref, (size_t)nmatch);
+
+            p += nmatch;
+        }
+        else                            // No, match overlaps output
+        {
+            while (nmatch-- > 0)
+            {
+                *p++ = *ref++;
+            }
+        }
+    }
+
+    return (p - dst == (ptrdiff_t)size) ? true : false;
+}
+
+
+///
+///  @brief    Uncompress page if it was compressed.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
 
-    if (page->prev == NULL)             // Only page in list?
+static void unpack_page(struct page *page)
+{
+    assert(page != NULL);
+
+    if (page->packed == 0)
     {
-        ptable[ostream].head = NULL;
-        ptable[ostream].tail = NULL;
+        return;
     }
-    else
+
+    char *data = alloc_mem(page->size + 1); // Allow for trailing NUL
+
+    if (!unpack_data((uchar *)page->addr, page->packed, (uchar *)data,
+                     page->size))
     {
-        ptable[ostream].tail        = page->prev;
+        free_mem(&data);
 
-        page->prev->next = NULL;
-        page->prev       = NULL;
-        page->next       = NULL;
+        errno = EIO;                    // Stored page was corrupted
+
+        throw(E_ERR, NULL);             // General error
     }
 
-    return page;
+    free_mem(&page->addr);
+
+    track_mem(MEM_PAGE, page->packed, page->size + 1);
+
+    page->addr   = data;
+    page->packed = 0;
 }
 
 
@@ -491,6 +1014,31 @@ static void write_page(FILE *fp, struct page *page)
     assert(fp != NULL);
     assert(page != NULL);
 
+    unpack_page(page);
+
+    ++stats[STAT_PAGES_WRITTEN];
+
+    track_mem(MEM_PAGE, page_bytes(page), (uint_t)0);
+
+    // If we don't need to add any CRs, then just write the page as is.
+
+    if (page->cr == 0)
+    {
+        stats[STAT_WRITE + ostream] += page->size + (page->ff ? 1 : 0);
+
+        fwrite(page->addr, (ulong)page->size, 1uL, fp);
+
+        if (page->ff)
+        {
+            fputc(FF, fp);
+        }
+
+        free_mem(&page->addr);
+        free_mem(&page);
+
+        return;
+    }
+
     char   last   = NUL;
     uint_t nbytes = page->size + page->cr + (page->ff ? 1 : 0);
     char   *src   = page->addr;
@@ -514,6 +1062,8 @@ static void write_page(FILE *fp, struct page *page)
         *p++ = FF;
     }
 
+    stats[STAT_WRITE + ostream] += nbytes;
+
     fwrite(dst, (ulong)nbytes, 1uL, fp);
 
     free_mem(&dst);
@@ -533,22 +1083,21 @@ void yank_backward(FILE *unused)
 {
     assert(ostream == OFILE_PRIMARY || ostream == OFILE_SECONDARY);
 
-    struct page *page;
+    struct page_table *table = &ptable[ostream];
+
+    kill_ebuf();
+    put_page(NULL);                     // Discard slot for current page
 
-    if (!pop_page())
+    if (table->current != 0 && get_page(table->current - 1))
     {
-        if ((page = unlink_page()) == NULL)
-        {
-            kill_ebuf();
-        }
-        else
-        {
-            copy_page(page);
-        }
+        return;
     }
 
-    if (ptable[ostream].count > 0)
+    if (table->npages != 0)
     {
-        --ptable[ostream].count;
+        insert_slot((uint_t)0);
     }
+
+    table->current = 0;
+    table->count   = 0;
 }
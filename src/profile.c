@@ -0,0 +1,653 @@
+///
+///  @file    profile.c
+///  @brief   TECO macro profiler.
+///
+///  @copyright 2019-2021 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "teco.h"
+#include "ascii.h"
+#include "eflags.h"
+#include "exec.h"
+#include "profile.h"
+#include "report.h"
+
+
+//  When E3&1024 is set, every command that is executed is timed, and the time
+//  is charged to an entry for that command, keyed by the command name, by the
+//  line it is on, and by the macro it is in. A macro is identified by the
+//  chain of M and EI commands that called it (e.g., "teco;EIlib;MA"), so that
+//  the same macro called from two different places gets separate entries.
+//
+//  The total time for an M or EI command includes the time for the commands
+//  in the macro it executed, while the self time does not. Search commands and
+//  file I/O commands are also totalled separately.
+//
+//  The results are written when TECO exits, or when E3&1024 is cleared. If a
+//  file name was specified with the --profile option, the results are written
+//  to that file, otherwise they are printed on the terminal. If the file name
+//  ends with ".folded", then the results are written in the collapsed stack
+//  format used by flame graph tools, with one line for each entry containing
+//  its macro chain, the command and its line number, and its self time in
+//  microseconds.
+
+
+#define ACTIVE_MAX      256             ///< Maximum nested commands profiled
+
+#define FOLDED          ".folded"       ///< File type for collapsed stacks
+
+
+///  @struct frame
+///  @brief  Macro called by an M or EI command.
+
+struct frame
+{
+    uint parent;                        ///< Index of calling macro
+    char *name;                         ///< Name of macro (e.g., "MA")
+};
+
+///  @struct entry
+///  @brief  Profile data for a command at a specific location.
+
+struct entry
+{
+    uint frame;                         ///< Index of macro
+    uint_t line;                        ///< Line number in macro
+    char c1;                            ///< 1st command character
+    char c2;                            ///< 2nd command character
+    uint_t count;                       ///< No. of times executed
+    nsec_t total;                       ///< Total time (incl. called macros)
+    nsec_t self;                        ///< Self time (excl. called macros)
+};
+
+///  @struct active
+///  @brief  Command currently being executed.
+
+struct active
+{
+    uint entry;                         ///< Index of entry for command
+    uint frame;                         ///< Index of macro command is in
+    nsec_t start;                       ///< Start time for command
+    nsec_t child;                       ///< Time in nested commands
+};
+
+///  @struct profile
+///  @brief  Profiler data.
+
+struct profile
+{
+    char *file;                         ///< Output file, or NULL
+    struct frame *frames;               ///< List of macros
+    uint nframes;                       ///< No. of macros
+    uint maxframes;                     ///< Allocated macros
+    struct entry *entries;              ///< List of entries
+    uint nentries;                      ///< No. of entries
+    uint maxentries;                    ///< Allocated entries
+    uint *hash;                         ///< Hash table of entry indices + 1
+    uint hashsize;                      ///< Size of hash table (power of 2)
+    uint frame;                         ///< Current macro
+    uint depth;                         ///< No. of active commands
+    bool changed;                       ///< Data changed since last written
+    struct active active[ACTIVE_MAX];   ///< Active commands
+    nsec_t search;                      ///< Total time in search commands
+    nsec_t io;                          ///< Total time in file I/O commands
+};
+
+static struct profile prof;             ///< Profiler data
+
+
+// Local functions
+
+static uint find_entry(uint frame, uint_t line, int c1, int c2);
+
+static uint find_frame(uint parent, const char *name, uint_t len);
+
+static uint_t get_path(char *buf, uint_t size, uint frame);
+
+static uint hash_entry(uint frame, uint_t line, int c1, int c2);
+
+static bool is_io(int c1, int c2);
+
+static bool is_search(int c1, int c2);
+
+static int sort_entry(const void *p1, const void *p2);
+
+
+///
+///  @brief    Execute command and record the time it took.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void exec_prof(void (*exec)(struct cmd *cmd), struct cmd *cmd)
+{
+    assert(exec != NULL);
+    assert(cmd != NULL);
+
+    if (prof.depth == ACTIVE_MAX)       // Too deeply nested to profile?
+    {
+        (*exec)(cmd);
+
+        return;
+    }
+
+    if (prof.frames == NULL)            // Create top level if needed
+    {
+        prof.frame = find_frame(0, "teco", (uint_t)strlen("teco"));
+    }
+
+    int c1 = toupper(cmd->c1);
+    int c2 = toupper(cmd->c2);
+    struct active *active = &prof.active[prof.depth++];
+
+    active->entry = find_entry(prof.frame, cmd_line, c1, c2);
+    active->frame = prof.frame;
+    active->child = 0;
+
+    // Commands that call a macro start a new frame for it.
+
+    if (c1 == 'M')
+    {
+        char name[] = { 'M', '.', cmd->qname, NUL };
+
+        if (!cmd->qlocal)
+        {
+            name[1] = name[2];
+            name[2] = NUL;
+        }
+
+        prof.frame = find_frame(prof.frame, name, (uint_t)strlen(name));
+    }
+    else if (c1 == 'E' && c2 == 'I' && cmd->text1.len != 0)
+    {
+        char name[2 + cmd->text1.len + 1];
+
+        snprintf(name, sizeof(name), "EI%.*s", (int)cmd->text1.len,
+                 cmd->text1.data);
+
+        prof.frame = find_frame(prof.frame, name, (uint_t)strlen(name));
+    }
+
+    active->start = get_nsec();
+
+    (*exec)(cmd);
+
+    nsec_t elapsed = get_nsec() - active->start;
+    struct entry *entry = &prof.entries[active->entry];
+
+    prof.frame = active->frame;
+
+    if (!f.e3.profile)                  // Was profiling just stopped?
+    {
+        --prof.depth;                   // Yes, don't record this command
+
+        return;
+    }
+
+    ++entry->count;
+
+    prof.changed = true;
+
+    entry->total += elapsed;
+    entry->self  += elapsed - active->child;
+
+    if (--prof.depth != 0)
+    {
+        prof.active[prof.depth - 1].child += elapsed;
+    }
+
+    if (is_search(c1, c2))
+    {
+        prof.search += elapsed;
+    }
+    else if (is_io(c1, c2))
+    {
+        prof.io += elapsed;
+    }
+}
+
+
+///
+///  @brief    Write results and clean up memory before we exit from TECO.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void exit_prof(void)
+{
+    write_prof();
+
+    for (uint i = 0; i < prof.nframes; ++i)
+    {
+        free_mem(&prof.frames[i].name);
+    }
+
+    free_mem(&prof.frames);
+    free_mem(&prof.entries);
+    free_mem(&prof.hash);
+    free_mem(&prof.file);
+
+    memset(&prof, '\0', sizeof(prof));
+}
+
+
+///
+///  @brief    Find entry for command, creating it if needed.
+///
+///  @returns  Index of entry.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint find_entry(uint frame, uint_t line, int c1, int c2)
+{
+    // Keep the hash table no more than half full.
+
+    if (prof.nentries * 2 >= prof.hashsize)
+    {
+        uint size = (prof.hashsize == 0) ? KB : prof.hashsize * 2;
+
+        free_mem(&prof.hash);
+
+        prof.hash     = alloc_mem((uint_t)(size * sizeof(*prof.hash)));
+        prof.hashsize = size;
+
+        for (uint i = 0; i < prof.nentries; ++i)
+        {
+            struct entry *entry = &prof.entries[i];
+            uint slot = hash_entry(entry->frame, entry->line, entry->c1,
+                                   entry->c2);
+
+            while (prof.hash[slot] != 0)
+            {
+                slot = (slot + 1) & (prof.hashsize - 1);
+            }
+
+            prof.hash[slot] = i + 1;
+        }
+    }
+
+    uint slot = hash_entry(frame, line, c1, c2);
+    uint i;
+
+    while ((i = prof.hash[slot]) != 0)
+    {
+        struct entry *entry = &prof.entries[i - 1];
+
+        if (entry->frame == frame && entry->line == line
+            && entry->c1 == (char)c1 && entry->c2 == (char)c2)
+        {
+            return i - 1;
+        }
+
+        slot = (slot + 1) & (prof.hashsize - 1);
+    }
+
+    if (prof.nentries == prof.maxentries)
+    {
+        uint_t size = (uint_t)sizeof(*prof.entries);
+
+        if (prof.entries == NULL)
+        {
+            prof.maxentries = KB;
+            prof.entries    = alloc_mem(prof.maxentries * size);
+        }
+        else
+        {
+            prof.entries = expand_mem(prof.entries, prof.maxentries * size,
+                                      prof.maxentries * size);
+            prof.maxentries *= 2;
+        }
+    }
+
+    i = prof.nentries++;
+
+    struct entry *entry = &prof.entries[i];
+
+    memset(entry, '\0', sizeof(*entry));
+
+    entry->frame = frame;
+    entry->line  = line;
+    entry->c1    = (char)c1;
+    entry->c2    = (char)c2;
+
+    prof.hash[slot] = i + 1;
+
+    return i;
+}
+
+
+///
+///  @brief    Find macro frame called from another frame, creating it if
+///            needed.
+///
+///  @returns  Index of frame.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint find_frame(uint parent, const char *name, uint_t len)
+{
+    assert(name != NULL);
+
+    for (uint i = 0; i < prof.nframes; ++i)
+    {
+        struct frame *frame = &prof.frames[i];
+
+        if (frame->parent == parent && strlen(frame->name) == len
+            && !memcmp(frame->name, name, (size_t)len))
+        {
+            return i;
+        }
+    }
+
+    if (prof.nframes == prof.maxframes)
+    {
+        uint_t size = (uint_t)sizeof(*prof.frames);
+
+        if (prof.frames == NULL)
+        {
+            prof.maxframes = 64;
+            prof.frames    = alloc_mem(prof.maxframes * size);
+        }
+        else
+        {
+            prof.frames = expand_mem(prof.frames, prof.maxframes * size,
+                                     prof.maxframes * size);
+            prof.maxframes *= 2;
+        }
+    }
+
+    struct frame *frame = &prof.frames[prof.nframes];
+
+    frame->parent = parent;
+    frame->name   = alloc_mem(len + 1);
+
+    memcpy(frame->name, name, (size_t)len);
+
+    return prof.nframes++;
+}
+
+
+///
+///  @brief    Get chain of macro names for frame (e.g., "teco;EIlib;MA").
+///
+///  @returns  No. of characters stored in buffer.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint_t get_path(char *buf, uint_t size, uint frame)
+{
+    assert(buf != NULL);
+
+    uint_t len = 0;
+
+    if (frame != 0)                     // Add caller's path first
+    {
+        len = get_path(buf, size, prof.frames[frame].parent);
+    }
+
+    int n = snprintf(buf + len, (size_t)(size - len), "%s%s",
+                     len == 0 ? "" : ";", prof.frames[frame].name);
+
+    if (n > 0)
+    {
+        len += (uint_t)n;
+    }
+
+    return (len < size) ? len : size - 1;
+}
+
+
+///
+///  @brief    Get hash table slot for command.
+///
+///  @returns  Slot index.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint hash_entry(uint frame, uint_t line, int c1, int c2)
+{
+    uint hash = frame * 31u + (uint)line;
+
+    hash = hash * 31u + (uint)(uchar)c1;
+    hash = hash * 31u + (uint)(uchar)c2;
+    hash ^= hash >> 16;
+
+    return hash & (prof.hashsize - 1);
+}
+
+
+///
+///  @brief    See if command performs file I/O.
+///
+///  @returns  true if I/O command, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool is_io(int c1, int c2)
+{
+    if (c1 == 'E')
+    {
+        return (c2 != NUL && strchr("ABCFKLNPQRWY%", c2) != NULL);
+    }
+
+    return (c1 == 'A' || c1 == 'P' || c1 == 'Y');
+}
+
+
+///
+///  @brief    See if command is a search command.
+///
+///  @returns  true if search command, else false.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool is_search(int c1, int c2)
+{
+    if (c1 == 'F')
+    {
+        return (c2 != NUL && strchr("BCDKNS_", c2) != NULL);
+    }
+    else if (c1 == 'E')
+    {
+        return (c2 == '_');
+    }
+
+    return (c1 == 'S' || c1 == 'N' || c1 == '_');
+}
+
+
+///
+///  @brief    Reset active commands after an error.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void reset_prof(void)
+{
+    prof.depth = 0;
+    prof.frame = 0;
+}
+
+
+///
+///  @brief    Set file for profile results.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void set_prof(const char *file)
+{
+    set_report(&prof.file, file);
+}
+
+
+///
+///  @brief    Compare entries for sorting by decreasing self time.
+///
+///  @returns  -1, 0, or 1.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int sort_entry(const void *p1, const void *p2)
+{
+    const struct entry *e1 = &prof.entries[*(const uint *)p1];
+    const struct entry *e2 = &prof.entries[*(const uint *)p2];
+
+    if (e1->self != e2->self)
+    {
+        return (e1->self > e2->self) ? -1 : 1;
+    }
+    else if (e1->frame != e2->frame)
+    {
+        return (e1->frame < e2->frame) ? -1 : 1;
+    }
+    else if (e1->line != e2->line)
+    {
+        return (e1->line < e2->line) ? -1 : 1;
+    }
+
+    return 0;
+}
+
+
+///
+///  @brief    Write profile results. These are cumulative, so each time they
+///            are written they include everything recorded so far.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void write_prof(void)
+{
+    if (!prof.changed)                  // Anything new recorded?
+    {
+        return;                         // No
+    }
+
+    prof.changed = false;
+
+    FILE *fp = NULL;
+    bool folded = false;
+
+    if (prof.file != NULL)
+    {
+        size_t len = strlen(prof.file);
+        size_t n   = strlen(FOLDED);
+
+        if (len > n && !strcmp(prof.file + len - n, FOLDED))
+        {
+            folded = true;
+        }
+
+        if ((fp = fopen(prof.file, "w")) == NULL)
+        {
+            tprint("%%Can't write profile to %s\n", prof.file);
+
+            folded = false;
+        }
+    }
+
+    uint *order = alloc_mem((uint_t)(prof.nentries * sizeof(*order)));
+    nsec_t total = 0;
+
+    for (uint i = 0; i < prof.nentries; ++i)
+    {
+        order[i] = i;
+        total += prof.entries[i].self;
+    }
+
+    qsort(order, (size_t)prof.nentries, sizeof(*order), sort_entry);
+
+    if (!folded)
+    {
+        print_report(fp, "Profile: %.3f ms total, %.3f ms in searches, "
+                     "%.3f ms in file I/O\n\n", (double)total / 1e6,
+                     (double)prof.search / 1e6, (double)prof.io / 1e6);
+        print_report(fp, "%10s %12s %12s  %-7s  %s\n", "Count", "Self (ms)",
+                     "Total (ms)", "Command", "Location");
+    }
+
+    for (uint i = 0; i < prof.nentries; ++i)
+    {
+        const struct entry *entry = &prof.entries[order[i]];
+        char path[PATH_MAX];
+        char name[5];
+        uint n = 0;
+
+        if (entry->count == 0)
+        {
+            continue;
+        }
+
+        // Control characters are printed in up-arrow format.
+
+        if (iscntrl(entry->c1))
+        {
+            name[n++] = '^';
+            name[n++] = (char)(entry->c1 + 'A' - 1);
+        }
+        else
+        {
+            name[n++] = entry->c1;
+        }
+
+        if (entry->c2 != NUL)
+        {
+            name[n++] = entry->c2;
+        }
+
+        name[n] = NUL;
+
+        (void)get_path(path, (uint_t)sizeof(path), entry->frame);
+
+        if (folded)
+        {
+            print_report(fp, "%s;%s line %u %llu\n", path, name,
+                         (uint)entry->line, entry->self / 1000);
+        }
+        else
+        {
+            print_report(fp, "%10u %12.3f %12.3f  %-7s  %s:%u\n",
+                         (uint)entry->count, (double)entry->self / 1e6,
+                         (double)entry->total / 1e6, name, path,
+                         (uint)entry->line);
+        }
+    }
+
+    free_mem(&order);
+
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+}
@@ -33,7 +33,9 @@
 #include "eflags.h"
 #include "errcodes.h"
 #include "exec.h"
+#include "flow.h"
 #include "qreg.h"
+#include "stats.h"
 #include "term.h"
 
 #include "cbuf.h"
@@ -126,12 +128,25 @@ static uint qstack_depth = 0;       ///< Current Q-register stack depth
 
 static struct qreg qglobal[QCOUNT];
 
+////////////////////////////////////////////////////////////////////////////////
+///
+///  Definitions for local Q-register sets. A new set is needed for every macro
+///  that is executed with an M command, but most macros use few if any local
+///  Q-registers, so a set is only created (or taken from a pool of previously
+///  freed sets) when a local Q-register is first referenced at a given macro
+///  level, and each set has a bitmap of the Q-registers actually referenced,
+///  so that only those need to be cleared when the macro ends.
+///
+////////////////////////////////////////////////////////////////////////////////
+
 ///  @struct qlocal
 ///  @brief  Local Q-register set.
 
 struct qlocal
 {
     struct qlocal *next;                ///< Next item in list
+    uint depth;                         ///< Macro level that owns this set
+    unsigned long long used;            ///< Bitmap of Q-registers referenced
     struct qreg qreg[QCOUNT];           ///< Local Q-register set
 };
 
@@ -145,6 +160,11 @@ static struct qlocal local_base;
 
 static struct qlocal *local_head = &local_base;
 
+///  @var    local_pool
+///  @brief  List of free local Q-register sets.
+
+static struct qlocal *local_pool = NULL;
+
 ////////////////////////////////////////////////////////////////////////////////
 ///
 ///  Definitions for Q-register push-down list. This is actually implemented as
@@ -167,11 +187,128 @@ struct qlist
 
 static struct qlist *list_head = NULL;
 
+////////////////////////////////////////////////////////////////////////////////
+///
+///  Definitions for shared Q-register text. Pushing a Q-register, popping it
+///  into another one, and executing it as a macro all share the text instead
+///  of copying it. Text that has more than one owner has an entry in the table
+///  below with a count of its owners, and is only copied when it is written,
+///  and only freed when its last owner lets go of it. Each Q-register also has
+///  a flag that is set when its text may be shared, so that unshared text can
+///  be modified without searching the table.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+///  @struct qshare
+///  @brief  Shared Q-register text.
+
+struct qshare
+{
+    char *data;                         ///< Shared text
+    uint refs;                          ///< No. of owners of text
+};
+
+static struct qshare *share_list = NULL; ///< List of shared text
+
+static uint share_count = 0;            ///< No. of entries in share list
+
+static uint share_size = 0;             ///< Allocated entries in share list
+
+#define QHOLD_MAX       (QSTACK_MAX * 2) ///< Maximum macro holds
+
+///  @var    holds
+///  @brief  Q-register text held by macros being executed.
+
+static tbuffer holds[QHOLD_MAX];
+
+static uint hold_depth = 0;             ///< Current no. of macro holds
+
+
+////////////////////////////////////////////////////////////////////////////////
+///
+///  Definitions for Q-register text blocks. Most Q-registers only ever hold a
+///  few characters, so rather than allocating a 1 KB block for each one, text
+///  of up to 1 KB is kept in blocks whose sizes are powers of two, starting at
+///  16 bytes, and blocks that are freed are kept in a pool for each size, for
+///  re-use the next time a block of that size is needed. The blocks are still
+///  allocated with alloc_mem(), and any left in the pools are freed on exit.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#define QBLOCK_MIN      16              ///< Smallest block size
+#define QBLOCK_MAX      KB              ///< Largest block size
+#define QBLOCK_SIZES    7               ///< No. of block sizes (16 to 1 KB)
+#define QBLOCK_POOL     64              ///< Maximum free blocks of each size
+
+///  @struct qblock
+///  @brief  Free Q-register text block.
+
+struct qblock
+{
+    struct qblock *next;                ///< Next free block of same size
+};
+
+///  @var    qpool
+///  @brief  Pools of free blocks for each size.
+
+static struct qblock *qpool[QBLOCK_SIZES];
+
+static uint qpool_count[QBLOCK_SIZES];  ///< No. of free blocks in each pool
+
 
 // Local functions
 
+static char *alloc_qblock(uint_t size);
+
+static void free_qblock(char **data, uint_t size);
+
+static void free_qlocal(struct qlocal *qlocal);
+
+static void free_text(struct qreg *qreg);
+
+static struct qreg *local_qreg(int qindex);
+
+static int qblock_index(uint_t size);
+
+static uint_t qblock_size(uint_t len);
+
 static inline struct qreg *qregister(int qindex);
 
+static void share_text(struct qreg *qreg);
+
+static bool unshare_text(const char *data);
+
+static void write_text(struct qreg *qreg);
+
+
+///
+///  @brief    Allocate block for Q-register text, using a free block from the
+///            pool if there is one of the right size.
+///
+///  @returns  Pointer to block.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static char *alloc_qblock(uint_t size)
+{
+    int i = qblock_index(size);
+
+    track_mem(MEM_QREG, (uint_t)0, size);
+
+    if (i != -1 && qpool[i] != NULL)
+    {
+        struct qblock *qblock = qpool[i];
+
+        qpool[i] = qblock->next;
+
+        --qpool_count[i];
+
+        return (char *)qblock;
+    }
+
+    return alloc_mem(size);
+}
+
 
 ///
 ///  @brief    Append character to Q-register.
@@ -188,15 +325,34 @@ void append_qchr(int qindex, int c)
     {
         qreg->text.pos  = 0;
         qreg->text.len  = 0;
-        qreg->text.size = KB;
-        qreg->text.data = alloc_mem((uint_t)qreg->text.size);
+        qreg->text.size = QBLOCK_MIN;
+        qreg->text.data = alloc_qblock(qreg->text.size);
     }
     else
     {
+        write_text(qreg);               // Text is being changed
+
         if (qreg->text.len == qreg->text.size)
         {
-            qreg->text.data = expand_mem(qreg->text.data, qreg->text.size, KB);
-            qreg->text.size += KB;
+            if (qreg->text.size < QBLOCK_MAX)
+            {
+                char *data = alloc_qblock(qreg->text.size * 2);
+
+                memcpy(data, qreg->text.data, (size_t)qreg->text.len);
+
+                free_qblock(&qreg->text.data, qreg->text.size);
+
+                qreg->text.data = data;
+            }
+            else
+            {
+                qreg->text.data = expand_mem(qreg->text.data, qreg->text.size,
+                                             qreg->text.size);
+
+                track_mem(MEM_QREG, qreg->text.size, qreg->text.size * 2);
+            }
+
+            qreg->text.size *= 2;
         }
     }
 
@@ -204,6 +360,49 @@ void append_qchr(int qindex, int c)
 }
 
 
+///
+///  @brief    Append text string to Q-register.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void append_qtext(int qindex, const char *text, uint_t len)
+{
+    assert(text != NULL);
+
+    struct qreg *qreg = qregister(qindex);
+
+    write_text(qreg);                   // Text is being changed
+
+    // If the result will still fit in a pool block, then move the text to a
+    // block that's big enough; otherwise append_tbuf() will handle it.
+
+    if (qreg->text.len <= QBLOCK_MAX && len <= QBLOCK_MAX - qreg->text.len
+        && qreg->text.len + len > qreg->text.size)
+    {
+        uint_t size = qblock_size(qreg->text.len + len);
+        char *data  = alloc_qblock(size);
+
+        if (qreg->text.data != NULL)
+        {
+            memcpy(data, qreg->text.data, (size_t)qreg->text.len);
+
+            free_qblock(&qreg->text.data, qreg->text.size);
+        }
+
+        qreg->text.data = data;
+        qreg->text.size = size;
+    }
+
+    uint_t oldsize = qreg->text.size;
+
+    append_tbuf(&qreg->text, text, len);
+
+    track_mem(MEM_QREG, oldsize, qreg->text.size);
+}
+
+
 ///
 ///  @brief    Delete text in Q-register.
 ///
@@ -215,11 +414,7 @@ void delete_qtext(int qindex)
 {
     struct qreg *qreg = qregister(qindex);
 
-    free_mem(&qreg->text.data);
-
-    qreg->text.size = 0;
-    qreg->text.len  = 0;
-    qreg->text.pos  = 0;
+    free_text(qreg);
 }
 
 
@@ -242,7 +437,7 @@ void exit_qreg(void)
     {
         list_head = savedq->next;
 
-        free_mem(&savedq->qreg.text.data);
+        free_text(&savedq->qreg);
         free_mem(&savedq);
     }
 
@@ -257,24 +452,146 @@ void exit_qreg(void)
 
         for (uint i = 0; i < QCOUNT; ++i)
         {
-            if (local_head->qreg[i].text.data != NULL)
-            {
-                free_mem(&local_head->qreg[i].text.data);
-            }
+            free_text(&local_head->qreg[i]);
         }
     }
 
+    struct qlocal *qlocal;
+
+    while ((qlocal = local_pool) != NULL)
+    {
+        local_pool = qlocal->next;
+
+        free_mem(&qlocal);
+    }
+
     // Free the global Q-registers
 
     for (uint i = 0; i < QCOUNT; ++i)
     {
-        struct qreg *qreg = &qglobal[i];
+        free_text(&qglobal[i]);
+    }
+
+    assert(share_count == 0);           // Error if any text still shared
+
+    free_mem(&share_list);
+
+    share_size = 0;
+
+    // Free the pools of Q-register text blocks
+
+    for (uint i = 0; i < QBLOCK_SIZES; ++i)
+    {
+        struct qblock *qblock;
 
-        free_mem(&qreg->text.data);
+        while ((qblock = qpool[i]) != NULL)
+        {
+            qpool[i] = qblock->next;
+
+            free_mem(&qblock);
+        }
+
+        qpool_count[i] = 0;
     }
 }
 
 
+///
+///  @brief    Free block of Q-register text, returning it to the pool for its
+///            size if it is a pool block and the pool isn't full.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void free_qblock(char **data, uint_t size)
+{
+    assert(data != NULL);
+
+    if (*data == NULL)
+    {
+        return;
+    }
+
+    track_mem(MEM_QREG, size, (uint_t)0);
+
+    int i = qblock_index(size);
+
+    if (i != -1 && qpool_count[i] < QBLOCK_POOL)
+    {
+        struct qblock *qblock = (struct qblock *)(void *)*data;
+
+        qblock->next = qpool[i];
+        qpool[i]     = qblock;
+
+        ++qpool_count[i];
+
+        *data = NULL;
+    }
+    else
+    {
+        free_mem(data);
+    }
+}
+
+
+///
+///  @brief    Free the text in a local Q-register set, and return the set to
+///            the pool for re-use. Only the Q-registers that were referenced
+///            need to be cleared.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void free_qlocal(struct qlocal *qlocal)
+{
+    assert(qlocal != NULL);
+
+    for (uint i = 0; qlocal->used != 0; ++i, qlocal->used >>= 1)
+    {
+        if (qlocal->used & 1)
+        {
+            free_text(&qlocal->qreg[i]);
+
+            qlocal->qreg[i].n = 0;
+        }
+    }
+
+    qlocal->next = local_pool;
+    local_pool   = qlocal;
+}
+
+
+///
+///  @brief    Free Q-register text, unless it is shared, in which case we just
+///            give up our share of it.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void free_text(struct qreg *qreg)
+{
+    assert(qreg != NULL);
+
+    if (qreg->text.data != NULL)
+    {
+        if (!qreg->shared || !unshare_text(qreg->text.data))
+        {
+            reset_flow(qreg->text.data);
+            free_qblock(&qreg->text.data, qreg->text.size);
+        }
+    }
+
+    qreg->text.data = NULL;
+    qreg->text.size = 0;
+    qreg->text.len  = 0;
+    qreg->text.pos  = 0;
+    qreg->shared    = false;
+}
+
+
 ///
 ///  @brief    Get size of text in all Q-registers.
 ///
@@ -393,14 +710,7 @@ int_t get_qnum(int qindex)
 
 struct qreg *get_qreg(int qindex)
 {
-    if (qindex >= QCOUNT)
-    {
-        return &local_head->qreg[qindex - QCOUNT];
-    }
-    else
-    {
-        return &qglobal[qindex];
-    }
+    return qregister(qindex);
 }
 
 
@@ -419,6 +729,34 @@ uint_t get_qsize(int qindex)
 }
 
 
+///
+///  @brief    Hold Q-register text for execution as a macro, so that it isn't
+///            freed or changed if the Q-register is modified by the macro. The
+///            hold must be released by release_qtext() after the macro ends.
+///
+///  @returns  Copy of Q-register text buffer.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+tbuffer hold_qtext(int qindex)
+{
+    struct qreg *qreg = qregister(qindex);
+
+    assert(qreg->text.data != NULL);    // Error if no text
+
+    if (hold_depth == QHOLD_MAX)
+    {
+        throw(E_MAX);
+    }
+
+    share_text(qreg);
+
+    holds[hold_depth++] = qreg->text;
+
+    return qreg->text;
+}
+
+
 ///
 ///  @brief    Initialize Q-register storage.
 ///
@@ -433,27 +771,62 @@ void init_qreg(void)
 
 
 ///
-///  @brief    Pop local Q-register set.
+///  @brief    Get local Q-register for current macro level, creating a new set
+///            of local Q-registers if this is the first one referenced.
 ///
-///  @returns  Nothing.
+///  @returns  Pointer to Q-register.
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-void pop_qlocal(void)
+static struct qreg *local_qreg(int qindex)
 {
-    struct qlocal *saved_set = local_head;
+    assert(qindex >= QCOUNT && qindex < QCOUNT * 2);
 
-    local_head = saved_set->next;
+    struct qlocal *qlocal = local_head;
 
-    for (uint i = 0; i < QCOUNT; ++i)
+    if (qlocal->depth != qlocal_depth)  // Need a new set for this level?
     {
-        if (saved_set->qreg[i].text.data != NULL)
+        if ((qlocal = local_pool) != NULL)
         {
-            free_mem(&saved_set->qreg[i].text.data);
+            local_pool = qlocal->next;
         }
+        else
+        {
+            qlocal = alloc_mem((uint_t)sizeof(*qlocal));
+        }
+
+        qlocal->next  = local_head;
+        qlocal->depth = qlocal_depth;
+        local_head    = qlocal;
     }
 
-    free_mem(&saved_set);
+    qindex -= QCOUNT;
+
+    qlocal->used |= 1uLL << qindex;
+
+    return &qlocal->qreg[qindex];
+}
+
+
+///
+///  @brief    Pop local Q-register set.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void pop_qlocal(void)
+{
+    assert(qlocal_depth != 0);          // Error if no set to pop
+
+    struct qlocal *saved_set = local_head;
+
+    if (saved_set->depth == qlocal_depth) // Was set created at this level?
+    {
+        local_head = saved_set->next;
+
+        free_qlocal(saved_set);
+    }
 
     --qlocal_depth;
 }
@@ -479,12 +852,9 @@ bool pop_qreg(int qindex)
 
     list_head = savedq->next;
 
-    if (qreg->text.data != NULL && qreg->text.data != savedq->qreg.text.data)
-    {
-        free_mem(&qreg->text.data);
-    }
+    free_text(qreg);
 
-    *qreg = savedq->qreg;
+    *qreg = savedq->qreg;               // Saved text now belongs to Q-register
 
     free_mem(&savedq);
 
@@ -505,16 +875,9 @@ void print_qreg(int qindex)
 {
     struct qreg *qreg = qregister(qindex);
 
-    for (uint_t i = 0; i < qreg->text.len; ++i)
+    if (qreg->text.len != 0)
     {
-        int c = qreg->text.data[i];
-
-        if (c == LF && f.e3.CR_type)
-        {
-            type_out(CR);
-        }
-
-        type_out(c);
+        type_text(qreg->text.data, qreg->text.len);
     }
 }
 
@@ -533,18 +896,13 @@ void push_qlocal(void)
         throw(E_MAX);
     }
 
-    ++qlocal_depth;
-
-    struct qlocal *qlocal = alloc_mem((uint_t)sizeof(*qlocal));
-
-    qlocal->next = local_head;
-
-    local_head = qlocal;
+    ++qlocal_depth;                     // Set is created when first used
 }
 
 
 ///
-///  @brief    Push (deep) copy of Q-register onto push-down list.
+///  @brief    Push copy of Q-register onto push-down list. The text is shared
+///            with the Q-register until one of them is modified.
 ///
 ///  @returns  true if success, false if push-down list is full.
 ///
@@ -562,28 +920,60 @@ bool push_qreg(int qindex)
     struct qreg *qreg    = qregister(qindex);
     struct qlist *savedq = alloc_mem((uint_t)sizeof(*savedq));
 
-    savedq->qreg.n         = qreg->n;
-    savedq->qreg.text.size = qreg->text.size;
-    savedq->qreg.text.pos  = qreg->text.pos;
-    savedq->qreg.text.len  = qreg->text.len;
+    share_text(qreg);
+
+    savedq->qreg = *qreg;
+    savedq->next = list_head;
+
+    list_head = savedq;
+
+    return true;
+}
+
+
+///
+///  @brief    Get index of pool for a Q-register text block.
+///
+///  @returns  Pool index, or -1 if not a pool block size.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static int qblock_index(uint_t size)
+{
+    int i = 0;
 
-    if (savedq->qreg.text.size == 0)
+    for (uint_t n = QBLOCK_MIN; n <= QBLOCK_MAX; n *= 2, ++i)
     {
-        savedq->qreg.text.data = NULL;
+        if (n == size)
+        {
+            return i;
+        }
     }
-    else
-    {
-        savedq->qreg.text.data = alloc_mem(savedq->qreg.text.size);
 
-        memcpy(savedq->qreg.text.data, qreg->text.data,
-               (size_t)savedq->qreg.text.size);
-    }
+    return -1;
+}
 
-    savedq->next = list_head;
 
-    list_head = savedq;
+///
+///  @brief    Get size of block needed for Q-register text.
+///
+///  @returns  Pool block size, or length of text if too big for a pool block.
+///
+////////////////////////////////////////////////////////////////////////////////
 
-    return true;
+static uint_t qblock_size(uint_t len)
+{
+    uint_t size = QBLOCK_MIN;
+
+    while (size < len)
+    {
+        if ((size *= 2) > QBLOCK_MAX)
+        {
+            return len;
+        }
+    }
+
+    return size;
 }
 
 
@@ -602,7 +992,31 @@ static inline struct qreg *qregister(int qindex)
     }
     else
     {
-        return &local_head->qreg[qindex - QCOUNT];
+        return local_qreg(qindex);
+    }
+}
+
+
+///
+///  @brief    Release Q-register text held for the macro that just ended.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void release_qtext(void)
+{
+    assert(hold_depth != 0);            // Error if nothing held
+
+    tbuffer *text = &holds[--hold_depth];
+
+    // If the text is no longer shared, then its Q-register has since been
+    // given new text, and the macro was the last owner of the old text.
+
+    if (!unshare_text(text->data))
+    {
+        reset_flow(text->data);
+        free_qblock(&text->data, text->size);
     }
 }
 
@@ -624,19 +1038,16 @@ void reset_qreg(void)
 
             local_head = saved_set->next;
 
-            for (uint i = 0; i < QCOUNT; ++i)
-            {
-                if (saved_set->qreg[i].text.data != NULL)
-                {
-                    free_mem(&saved_set->qreg[i].text.data);
-                }
-            }
-
-            free_mem(&saved_set);
+            free_qlocal(saved_set);
         }
     }
 
     qlocal_depth = 0;
+
+    while (hold_depth != 0)             // Release text held by macros
+    {
+        release_qtext();
+    }
 }
 
 
@@ -696,6 +1107,55 @@ void scan_qreg(struct cmd *cmd)
 }
 
 
+///
+///  @brief    Add an owner to Q-register text.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void share_text(struct qreg *qreg)
+{
+    assert(qreg != NULL);
+
+    if (qreg->text.data == NULL)
+    {
+        return;
+    }
+
+    qreg->shared = true;
+
+    for (uint i = 0; i < share_count; ++i)
+    {
+        if (share_list[i].data == qreg->text.data)
+        {
+            ++share_list[i].refs;
+
+            return;
+        }
+    }
+
+    uint_t size = (uint_t)sizeof(*share_list);
+
+    if (share_list == NULL)
+    {
+        share_size = QSTACK_MAX;
+        share_list = alloc_mem(share_size * size);
+    }
+    else if (share_count == share_size)
+    {
+        share_list = expand_mem(share_list, share_size * size,
+                                share_size * size);
+        share_size *= 2;
+    }
+
+    share_list[share_count].data = qreg->text.data;
+    share_list[share_count].refs = 2;   // Original owner plus new one
+
+    ++share_count;
+}
+
+
 ///
 ///  @brief    Store character in Q-register.
 ///
@@ -707,12 +1167,10 @@ void store_qchr(int qindex, int c)
 {
     struct qreg *qreg = qregister(qindex);
 
-    free_mem(&qreg->text.data);
+    free_text(qreg);
 
-    qreg->text.pos  = 0;
-    qreg->text.len  = 0;
-    qreg->text.size = KB;
-    qreg->text.data = alloc_mem(qreg->text.size);
+    qreg->text.size = QBLOCK_MIN;
+    qreg->text.data = alloc_qblock(qreg->text.size);
 
     qreg->text.data[qreg->text.len++] = (char)c;
 }
@@ -747,7 +1205,73 @@ void store_qtext(int qindex, tbuffer *text)
 
     struct qreg *qreg = get_qreg(qindex);
 
-    free_mem(&qreg->text.data);
+    free_text(qreg);
+
+    track_mem(MEM_QREG, (uint_t)0, text->size);
 
     qreg->text = *text;
 }
+
+
+///
+///  @brief    Remove an owner from Q-register text.
+///
+///  @returns  true if text was shared (and is still owned by someone else),
+///            false if it was not shared.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static bool unshare_text(const char *data)
+{
+    for (uint i = 0; i < share_count; ++i)
+    {
+        if (share_list[i].data == data)
+        {
+            if (--share_list[i].refs == 1)
+            {
+                share_list[i] = share_list[--share_count];
+            }
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+///
+///  @brief    Prepare to modify Q-register text, first making a private copy
+///            of it if it is shared.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void write_text(struct qreg *qreg)
+{
+    assert(qreg != NULL);
+
+    if (qreg->text.data == NULL)
+    {
+        return;
+    }
+
+    if (qreg->shared)
+    {
+        qreg->shared = false;
+
+        if (unshare_text(qreg->text.data))
+        {
+            char *data = alloc_qblock(qreg->text.size);
+
+            memcpy(data, qreg->text.data, (size_t)qreg->text.len);
+
+            qreg->text.data = data;
+
+            return;
+        }
+    }
+
+    reset_flow(qreg->text.data);
+}
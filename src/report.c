@@ -0,0 +1,108 @@
+///
+///  @file    report.c
+///  @brief   Timing and report functions shared by the macro profiler and the
+///           command trace ring.
+///
+///  @copyright 2019-2021 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "teco.h"
+#include "ascii.h"
+#include "report.h"
+
+
+///
+///  @brief    Get current time from monotonic clock.
+///
+///  @returns  Time in nanoseconds.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+nsec_t get_nsec(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (nsec_t)ts.tv_sec * 1000000000uLL + (nsec_t)ts.tv_nsec;
+}
+
+
+///
+///  @brief    Print line of report to file, or to terminal if no file.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void print_report(FILE *fp, const char *format, ...)
+{
+    assert(format != NULL);
+
+    char line[PATH_MAX + 100];
+    va_list args;
+
+    va_start(args, format);
+
+    (void)vsnprintf(line, sizeof(line), format, args);
+
+    va_end(args);
+
+    if (fp != NULL)
+    {
+        fputs(line, fp);
+    }
+    else
+    {
+        tprint("%s", line);
+    }
+}
+
+
+///
+///  @brief    Set (or clear) name of file for report.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void set_report(char **file, const char *name)
+{
+    assert(file != NULL);
+
+    free_mem(file);
+
+    if (name != NULL && *name != NUL)
+    {
+        uint_t len = (uint_t)strlen(name);
+
+        *file = alloc_mem(len + 1);
+
+        memcpy(*file, name, (size_t)len);
+    }
+}
@@ -0,0 +1,337 @@
+///
+///  @file    ring.c
+///  @brief   TECO command trace ring.
+///
+///  @copyright 2019-2021 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "teco.h"
+#include "ascii.h"
+#include "editbuf.h"
+#include "eflags.h"
+#include "exec.h"
+#include "report.h"
+#include "ring.h"
+
+
+//  When E3&2048 is set, a compact record of each command executed is saved in
+//  a fixed-size ring, instead of each command character being echoed on the
+//  terminal as is done by the ? command. This costs little enough that it can
+//  be left on for long-running macros, or for problems that depend on timing.
+//
+//  Each record contains the time, the command characters and any Q-register
+//  name, the m and n arguments and modifiers, the values of dot and Z, the
+//  line number, and the macro depth. Once the ring is full, each new record
+//  replaces the oldest one.
+//
+//  The ring is dumped whenever an error occurs (which includes aborting a
+//  command with CTRL/C), and when E3&2048 is cleared. Records are converted to
+//  readable form only when they are dumped, and each dump only includes the
+//  commands executed since the previous one. If a file name was specified with
+//  the --ring option, dumps are appended to that file, otherwise they are
+//  printed on the terminal.
+
+
+#define RING_SIZE       4096            ///< No. of records (must be power of 2)
+
+#define REC_M           1               ///< m argument is valid
+#define REC_N           2               ///< n argument is valid
+#define REC_H           4               ///< H found
+#define REC_COLON       8               ///< : found
+#define REC_DCOLON      16              ///< :: found
+#define REC_ATSIGN      32              ///< @ found
+#define REC_QLOCAL      64              ///< Q-register is local
+
+
+///  @struct record
+///  @brief  Trace data for one command.
+
+struct record
+{
+    nsec_t time;                        ///< Time command started
+    int_t m_arg;                        ///< m argument
+    int_t n_arg;                        ///< n argument
+    int_t dot;                          ///< Value of dot
+    int_t Z;                            ///< Value of Z
+    uint_t line;                        ///< Line number in macro
+    unsigned short depth;               ///< Macro depth
+    unsigned char flags;                ///< REC_xxx flags
+    char c1;                            ///< 1st command character
+    char c2;                            ///< 2nd command character
+    char c3;                            ///< 3rd command character
+    char qname;                         ///< Q-register name
+};
+
+///  @struct ring
+///  @brief  Trace ring data.
+
+struct ring
+{
+    char *file;                         ///< Output file, or NULL
+    struct record *records;             ///< Ring of records
+    uint next;                          ///< Index of next record
+    uint count;                         ///< No. of records since last dump
+};
+
+static struct ring ring;                ///< Trace ring data
+
+
+// Local functions
+
+static uint decode_chr(char *buf, int c);
+
+static void decode_record(char *buf, uint_t size, const struct record *rec);
+
+
+///
+///  @brief    Convert command character to printable form, the same way that
+///            it would be echoed when tracing.
+///
+///  @returns  No. of characters stored in buffer (1 or 2).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static uint decode_chr(char *buf, int c)
+{
+    assert(buf != NULL);
+
+    c &= 0xFF;
+
+    if (c == ESC)
+    {
+        buf[0] = '$';
+    }
+    else if (c < SPACE || c == DEL)
+    {
+        buf[0] = '^';
+        buf[1] = (char)(c ^ 0x40);
+
+        return 2;
+    }
+    else
+    {
+        buf[0] = (char)c;
+    }
+
+    return 1;
+}
+
+
+///
+///  @brief    Convert trace record to the command string that was executed.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void decode_record(char *buf, uint_t size, const struct record *rec)
+{
+    assert(buf != NULL);
+    assert(rec != NULL);
+
+    int n = 0;
+
+    if (rec->flags & REC_H)
+    {
+        n = snprintf(buf, (size_t)size, "H");
+    }
+    else if (rec->flags & REC_M)
+    {
+        n = snprintf(buf, (size_t)size, "%ld,%ld", (long)rec->m_arg,
+                     (long)rec->n_arg);
+    }
+    else if (rec->flags & REC_N)
+    {
+        n = snprintf(buf, (size_t)size, "%ld", (long)rec->n_arg);
+    }
+
+    char *p = buf + n;
+
+    if (rec->flags & REC_DCOLON)
+    {
+        *p++ = ':';
+        *p++ = ':';
+    }
+    else if (rec->flags & REC_COLON)
+    {
+        *p++ = ':';
+    }
+
+    if (rec->flags & REC_ATSIGN)
+    {
+        *p++ = '@';
+    }
+
+    p += decode_chr(p, rec->c1);
+
+    if (rec->c2 != NUL)
+    {
+        p += decode_chr(p, rec->c2);
+    }
+
+    if (rec->c3 != NUL)
+    {
+        p += decode_chr(p, rec->c3);
+    }
+
+    if (rec->qname != NUL)
+    {
+        if (rec->flags & REC_QLOCAL)
+        {
+            *p++ = '.';
+        }
+
+        p += decode_chr(p, rec->qname);
+    }
+
+    *p = NUL;
+}
+
+
+///
+///  @brief    Dump records made since the last dump, oldest first.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void dump_ring(void)
+{
+    if (ring.count == 0)                // Anything new recorded?
+    {
+        return;                         // No
+    }
+
+    FILE *fp = NULL;
+
+    if (ring.file != NULL && (fp = fopen(ring.file, "a")) == NULL)
+    {
+        tprint("%%Can't write trace to %s\n", ring.file);
+    }
+
+    uint first = (ring.next - ring.count) & (RING_SIZE - 1);
+    nsec_t start = ring.records[first].time;
+
+    print_report(fp, "Trace: %u commands\n\n", ring.count);
+    print_report(fp, "%12s %5s %6s %10s %10s  %s\n", "Time (us)", "Depth",
+                 "Line", "Dot", "Z", "Command");
+
+    for (uint i = 0; i < ring.count; ++i)
+    {
+        const struct record *rec = &ring.records[(first + i) & (RING_SIZE - 1)];
+        char cmd[80];
+
+        decode_record(cmd, (uint_t)sizeof(cmd), rec);
+
+        print_report(fp, "%12.3f %5u %6u %10ld %10ld  %s\n",
+                     (double)(rec->time - start) / 1e3, (uint)rec->depth,
+                     (uint)rec->line, (long)rec->dot, (long)rec->Z, cmd);
+    }
+
+    ring.count = 0;
+
+    if (fp != NULL)
+    {
+        fclose(fp);
+    }
+}
+
+
+///
+///  @brief    Clean up memory before we exit from TECO.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void exit_ring(void)
+{
+    free_mem(&ring.records);
+    free_mem(&ring.file);
+
+    memset(&ring, '\0', sizeof(ring));
+}
+
+
+///
+///  @brief    Save record for command about to be executed.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void record_ring(const struct cmd *cmd)
+{
+    assert(cmd != NULL);
+
+    if (ring.records == NULL)
+    {
+        ring.records = alloc_mem((uint_t)(RING_SIZE * sizeof(*ring.records)));
+    }
+
+    struct record *rec = &ring.records[ring.next];
+
+    ring.next = (ring.next + 1) & (RING_SIZE - 1);
+
+    if (ring.count < RING_SIZE)
+    {
+        ++ring.count;
+    }
+
+    rec->time  = get_nsec();
+    rec->m_arg = cmd->m_arg;
+    rec->n_arg = cmd->n_arg;
+    rec->dot   = t.dot;
+    rec->Z     = t.Z;
+    rec->line  = cmd_line;
+    rec->depth = (unsigned short)getmacro_depth();
+    rec->c1    = cmd->c1;
+    rec->c2    = cmd->c2;
+    rec->c3    = cmd->c3;
+    rec->qname = cmd->qname;
+    rec->flags = 0;
+
+    if (cmd->m_set)   rec->flags |= REC_M;
+    if (cmd->n_set)   rec->flags |= REC_N;
+    if (cmd->h)       rec->flags |= REC_H;
+    if (cmd->colon)   rec->flags |= REC_COLON;
+    if (cmd->dcolon)  rec->flags |= REC_DCOLON;
+    if (cmd->atsign)  rec->flags |= REC_ATSIGN;
+    if (cmd->qlocal)  rec->flags |= REC_QLOCAL;
+}
+
+
+///
+///  @brief    Set file for trace dumps.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void set_ring(const char *file)
+{
+    set_report(&ring.file, file);
+}
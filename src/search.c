@@ -41,6 +41,7 @@
 #include "page.h"
 #include "qreg.h"
 #include "search.h"
+#include "stats.h"
 #include "term.h"
 
 
@@ -77,11 +78,18 @@ void build_search(const char *src, uint_t len)
 
     last_len = 0;                       // Assume search will fail
 
-    free_mem(&last_search.data);
+    if (last_search.data != NULL)
+    {
+        track_mem(MEM_SEARCH, last_search.len + 1, (uint_t)0);
+
+        free_mem(&last_search.data);
+    }
 
     last_search.data = alloc_mem(tmp.len + 1);
     last_search.len = tmp.len;
 
+    track_mem(MEM_SEARCH, (uint_t)0, last_search.len + 1);
+
     strcpy(last_search.data, tmp.data);
 }
 
@@ -415,8 +423,12 @@ bool search_backward(struct search *s)
         s->match_len = last_search.len; // No. of characters left to match
         s->match_buf = last_search.data; // Start of match characters
 
+        ++stats[STAT_SEARCH_TRIES];
+
         if (match_str(s))
         {
+            ++stats[STAT_SEARCH_MATCHES];
+
             return true;
         }
     }
@@ -493,8 +505,12 @@ bool search_forward(struct search *s)
         s->match_len = last_search.len; // No. of characters left to match
         s->match_buf = last_search.data; // Start of match characters
 
+        ++stats[STAT_SEARCH_TRIES];
+
         if (match_str(s))
         {
+            ++stats[STAT_SEARCH_MATCHES];
+
             // The following affects how much we move dot on multiple occurrence
             // searches. Normally we skip over the whole matched string when
             // proceeding to the nth search match. But if movedot is set, then
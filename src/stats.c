@@ -0,0 +1,175 @@
+///
+///  @file    stats.c
+///  @brief   TECO performance counters.
+///
+///  @copyright 2019-2021 Franklin P. Johnston / Nowwith Treble Software
+///
+///  Permission is hereby granted, free of charge, to any person obtaining a
+///  copy of this software and associated documentation files (the "Software"),
+///  to deal in the Software without restriction, including without limitation
+///  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+///  and/or sell copies of the Software, and to permit persons to whom the
+///  Software is furnished to do so, subject to the following conditions:
+///
+///  The above copyright notice and this permission notice shall be included in
+///  all copies or substantial portions of the Software.
+///
+///  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+///  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+///  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+///  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIA-
+///  BILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+///  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+///  THE SOFTWARE.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "teco.h"
+#include "stats.h"
+
+
+//  The counters below are always maintained, since each is just an increment
+//  in a function that does much more work than that. They may be read with
+//  the n::EJ command, and are printed at exit if the --stats option is used.
+//
+//  The memory counters are kept by each subsystem calling track_mem() when
+//  it allocates, resizes, or deallocates a block that it owns, since in
+//  normal builds we don't keep track of the sizes of individual blocks.
+
+///  @var     stats
+///  @brief   Performance counters.
+
+unsigned long long stats[STAT_MAX];
+
+///  @var     stat_names
+///  @brief   Descriptions of performance counters.
+
+static const char * const stat_names[STAT_MAX] =
+{
+    [STAT_NONE]            = NULL,
+    [STAT_GAP_MOVES]       = "Edit buffer gap moves",
+    [STAT_GAP_BYTES]       = "Edit buffer bytes moved",
+    [STAT_RESIZES]         = "Edit buffer resizes",
+    [STAT_RESIZE_BYTES]    = "Edit buffer bytes reallocated",
+    [STAT_ADDS]            = "Edit buffer additions",
+    [STAT_DELETES]         = "Edit buffer deletions",
+    [STAT_PAGES_MADE]      = "Pages made",
+    [STAT_PAGES_COPIED]    = "Pages copied",
+    [STAT_PAGES_WRITTEN]   = "Pages written",
+    [STAT_READ]            = "Bytes read (primary)",
+    [STAT_READ_SECONDARY]  = "Bytes read (secondary)",
+    [STAT_READ_QREGISTER]  = "Bytes read (EQ)",
+    [STAT_READ_INDIRECT]   = "Bytes read (EI)",
+    [STAT_WRITE]           = "Bytes written (primary)",
+    [STAT_WRITE_SECONDARY] = "Bytes written (secondary)",
+    [STAT_WRITE_QREGISTER] = "Bytes written (E%)",
+    [STAT_WRITE_LOG]       = "Bytes written (EL)",
+    [STAT_SEARCH_TRIES]    = "Search positions tried",
+    [STAT_SEARCH_MATCHES]  = "Search matches",
+    [STAT_ALLOCS]          = "Memory allocations",
+    [STAT_ALLOC_BYTES]     = "Memory bytes allocated",
+    [STAT_EXPANDS]         = "Memory expansions",
+    [STAT_EXPAND_BYTES]    = "Memory bytes expanded",
+    [STAT_MEM]             = "Edit buffer bytes",
+    [STAT_MEM_PAGE]        = "Page bytes",
+    [STAT_MEM_QREG]        = "Q-register bytes",
+    [STAT_MEM_CBUF]        = "Command buffer bytes",
+    [STAT_MEM_SEARCH]      = "Search string bytes",
+    [STAT_PEAK]            = "Edit buffer bytes (peak)",
+    [STAT_PEAK_PAGE]       = "Page bytes (peak)",
+    [STAT_PEAK_QREG]       = "Q-register bytes (peak)",
+    [STAT_PEAK_CBUF]       = "Command buffer bytes (peak)",
+    [STAT_PEAK_SEARCH]     = "Search string bytes (peak)",
+};
+
+///  @var     print_stats
+///  @brief   true if counters should be printed at exit.
+
+static bool print_stats = false;
+
+
+///
+///  @brief    Print performance counters if requested.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void exit_stats(void)
+{
+    if (!print_stats)
+    {
+        return;
+    }
+
+    print_stats = false;
+
+    tprint("Statistics:\n\n");
+
+    for (int i = STAT_NONE + 1; i < STAT_MAX; ++i)
+    {
+        tprint("%2d  %-30s %12llu\n", i, stat_names[i], stats[i]);
+    }
+}
+
+
+///
+///  @brief    Get performance counter (for n::EJ command).
+///
+///  @returns  Counter value, or no. of counters if n is 0, or -1 if n is not
+///            a valid counter.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+long long get_stat(int n)
+{
+    if (n == STAT_NONE)
+    {
+        return STAT_MAX - 1;
+    }
+    else if (n < STAT_NONE || n >= STAT_MAX)
+    {
+        return -1;
+    }
+
+    return (long long)stats[n];
+}
+
+
+///
+///  @brief    Enable or disable printing of counters at exit.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void set_stats(bool enable)
+{
+    print_stats = enable;
+}
+
+
+///
+///  @brief    Track memory used by a subsystem, when a block it owns changes
+///            size (oldsize is 0 for a new block, and newsize is 0 for a
+///            deallocated block).
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void track_mem(enum mem_tag tag, uint_t oldsize, uint_t newsize)
+{
+    unsigned long long *current = &stats[STAT_MEM + tag];
+
+    *current += newsize;
+    *current -= oldsize;
+
+    if (stats[STAT_PEAK + tag] < *current)
+    {
+        stats[STAT_PEAK + tag] = *current;
+    }
+}
@@ -47,12 +47,17 @@
 #include "ascii.h"
 #include "cbuf.h"
 #include "display.h"
+#include "each.h"
 #include "editbuf.h"
 #include "eflags.h"
 #include "estack.h"
 #include "exec.h"
 #include "file.h"
+#include "flow.h"
+#include "profile.h"
 #include "qreg.h"
+#include "ring.h"
+#include "stats.h"
 #include "term.h"
 
 //lint -save -e10 -e65 -e133 -e485 -e651
@@ -155,8 +160,6 @@ static void exit_teco(void);
 
 static void init_teco(int argc, const char * const argv[]);
 
-static void reset_teco(void);
-
 
 ///
 ///  @brief    Main program entry for TECO-64 text editor.
@@ -193,6 +196,7 @@ int main(int argc, const char * const argv[])
 
                 if (!f.e0.init && !read_EI())
                 {
+                    exec_each();        // Process files for --each option
                     read_cmd();         // Read input from terminal
                 }
 
@@ -261,9 +265,13 @@ static void exit_teco(void)
     reset_loop();                       // Deallocate memory for loops
     reset_indirect();                   // Deallocate memory for EI commands
 
+    exit_prof();                        // Write profile and deallocate memory
+    exit_ring();                        // Deallocate memory for trace ring
+    exit_stats();                       // Print performance counters
     exit_map();                         // Deallocate memory for key mapping
     exit_error();                       // Deallocate memory for errors
     exit_qreg();                        // Deallocate memory for Q-registers
+    exit_flow();                        // Deallocate memory for flow tables
     exit_ebuf();                        // Deallocate memory for edit buffer
     exit_cbuf();                        // Deallocate memory for command buffer
     exit_tbuf();                        // Deallocate memory for terminal buffer
@@ -331,7 +339,7 @@ static void init_teco(int argc, const char * const argv[])
 ///
 ////////////////////////////////////////////////////////////////////////////////
 
-static void reset_teco(void)
+void reset_teco(void)
 {
     init_x();                           // Reinitialize expression stack
     reset_if();                         // Reset conditional stack
@@ -340,4 +348,5 @@ static void reset_teco(void)
     reset_indirect();                   // Reset indirect command file
     reset_qreg();                       // Free up local Q-register storage
     reset_macro();                      // Reset macro stack
+    reset_prof();                       // Reset profiler
 }
@@ -52,6 +52,7 @@
 #include "eflags.h"
 #include "errcodes.h"
 #include "exec.h"
+#include "file.h"
 #include "qreg.h"
 #include "term.h"
 
@@ -706,6 +707,7 @@ static int read_nowait(void)
 
 static int read_wait(void)
 {
+    flush_log();                        // Update log before we wait
 
 #if     defined(DISPLAY_MODE)
 
@@ -723,6 +725,11 @@ static int read_wait(void)
 #endif
 
     {
+        if (f.e0.batch)                 // Flush any buffered output first
+        {
+            (void)fflush(stdout);
+        }
+
         char chr;
         ssize_t nbytes = read(fileno(stdin), &chr, sizeof(chr));
 
@@ -36,6 +36,7 @@
 #include "editbuf.h"
 #include "eflags.h"
 #include "file.h"
+#include "stats.h"
 #include "term.h"
 
 
@@ -70,6 +71,8 @@ static const char *table_8bit[] =       ///< 8-bit characters
 
 static void tputc(int c, int input);
 
+static void twrite(const char *text, uint_t len);
+
 
 ///
 ///  @brief    Echo input character.
@@ -357,12 +360,75 @@ static void tputc(int c, int input)
 
         if (fp != NULL && ((input && !f.e3.noin) || (!input && !f.e3.noout)))
         {
+            ++stats[STAT_WRITE_LOG];
+
             fputc(c, fp);
         }
     }
 }
 
 
+///
+///  @brief    Output run of printable characters (and possibly LFs) to terminal
+///            and log file, with the same effect as calling tputc() for each
+///            of them. This is only called if display mode is not active.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+static void twrite(const char *text, uint_t len)
+{
+    assert(text != NULL);
+
+    uint_t nbytes = len;
+    uint_t last = len;
+
+    while (last > 0 && text[last - 1] != LF)
+    {
+        --last;
+    }
+
+    if (last != 0)                      // Any LFs in run?
+    {
+        term_pos = (int)(len - last);
+    }
+    else if (f.et.truncate)             // Only print what fits on line
+    {
+        int avail = w.width - term_pos - 1;
+
+        if (avail <= 0)
+        {
+            nbytes = 0;
+        }
+        else if (nbytes > (uint_t)avail)
+        {
+            nbytes = (uint_t)avail;
+        }
+
+        term_pos += (int)len;
+    }
+    else
+    {
+        term_pos += (int)len;
+    }
+
+    if (nbytes != 0)
+    {
+        (void)fwrite(text, 1uL, (size_t)nbytes, stdout);
+
+        FILE *fp = ofiles[OFILE_LOG].fp;
+
+        if (fp != NULL && !f.e3.noout)
+        {
+            stats[STAT_WRITE_LOG] += nbytes;
+
+            (void)fwrite(text, 1uL, (size_t)nbytes, fp);
+        }
+    }
+}
+
+
 ///
 ///  @brief    Type output character.
 ///
@@ -469,3 +535,68 @@ void type_out(int c)
         tprint("%s", table_8bit[c & 0x7f]);
     }
 }
+
+
+///
+///  @brief    Type out block of text. This has the same effect as calling
+///            type_out() for each character (preceded by a CR for each LF if
+///            E3&256 is set), but runs of printable characters are output
+///            with a single write, so that typing out a large buffer is not
+///            limited by the time spent on each character.
+///
+///  @returns  Nothing.
+///
+////////////////////////////////////////////////////////////////////////////////
+
+void type_text(const char *text, uint_t len)
+{
+    assert(text != NULL);
+
+    const char *end = text + len;
+    bool fast = (f.eu == -1);           // Only if no case flagging
+
+#if     defined(DISPLAY_MODE)
+
+    if (f.e0.display)
+    {
+        fast = false;
+    }
+
+#endif
+
+    // LFs can be included in a run unless we have to add CRs, or we have to
+    // truncate lines, in which case we need to know where each line starts.
+
+    bool lf_ok = !f.e3.CR_type && !f.et.truncate;
+
+    while (text < end)
+    {
+        if (fast)
+        {
+            const char *p = text;
+
+            while (p < end && (isprint((uchar)*p) || (*p == LF && lf_ok)))
+            {
+                ++p;
+            }
+
+            if (p != text)
+            {
+                twrite(text, (uint_t)(p - text));
+
+                text = p;
+
+                continue;
+            }
+        }
+
+        int c = *text++;
+
+        if (c == LF && f.e3.CR_type)
+        {
+            type_out(CR);
+        }
+
+        type_out(c);
+    }
+}
@@ -45,9 +45,12 @@
 #include "eflags.h"
 #include "errcodes.h"
 #include "exec.h"
+#include "file.h"
 #include "term.h"
 
 
+#define BATCH_BUFSIZ    (64 * KB)       ///< Output buffer size in batch mode
+
 #if     !defined(__DECC)
 
 static struct termios saved_mode;       ///< Saved terminal mode
@@ -126,7 +129,7 @@ void init_term(void)
 {
 #if     !defined(__DECC)
 
-    if (!f.e0.i_redir)
+    if (!f.e0.i_redir && !f.e0.batch)
     {
         (void)tcgetattr(fileno(stdin), &saved_mode);
     }
@@ -142,6 +145,45 @@ void init_term(void)
 
     (void)sigaction(SIGINT, &sa, NULL);
     (void)sigaction(SIGABRT, &sa, NULL); // (mostly for assertion failures)
+    (void)sigaction(SIGBUS, &sa, NULL);
+    (void)sigaction(SIGFPE, &sa, NULL);
+    (void)sigaction(SIGSEGV, &sa, NULL);
+
+    // Open the keystroke file (if any) before checking for batch mode, so
+    // that --keys works with --batch.
+
+    if (key_name != NULL && key_fp == NULL)
+    {
+        if ((key_fp = fopen(key_name, "w+")) != NULL)
+        {
+            // Write output immediately and do not buffer.
+
+            (void)setvbuf(key_fp, NULL, _IONBF, 0uL);
+        }
+    }
+
+    // In batch mode, we don't use the terminal at all, so we skip getting its
+    // size and changing its mode, and we buffer output in large blocks rather
+    // than writing each character as it is typed out. Output is flushed when
+    // we read from stdin, and when we exit.
+
+    if (f.e0.batch)
+    {
+        static bool batch_active = false;
+
+        if (!batch_active)
+        {
+            batch_active = true;
+
+            (void)setvbuf(stdout, NULL, _IOFBF, (size_t)BATCH_BUFSIZ);
+        }
+
+        f.et.lower    = true;           // Input can be in lower case
+        f.et.scope    = false;          // No display mode
+        f.et.eightbit = true;           // Output can use 8-bit characters
+
+        return;
+    }
 
 #if !defined(__DECC)
 
@@ -170,16 +212,6 @@ void init_term(void)
 
     getsize();
 
-    if (key_name != NULL)
-    {
-        if ((key_fp = fopen(key_name, "w+")) != NULL)
-        {
-            // Write output immediately and do not buffer.
-
-            (void)setvbuf(key_fp, NULL, _IONBF, 0uL);
-        }
-    }
-
     // The following is needed only if there is no display active and we haven't
     // already initialized the terminal mode.
 
@@ -297,6 +329,21 @@ static void sig_handler(int signum)
 
             break;
 
+        case SIGBUS:
+        case SIGFPE:
+        case SIGSEGV:
+            flush_log();                // Save as much of log as we can
+
+            if (f.e0.batch)
+            {
+                (void)fflush(stdout);   // And any buffered output
+            }
+
+            (void)signal(signum, SIG_DFL);
+            (void)raise(signum);        // Then crash as we would have before
+
+            break;
+
         case SIGINT:
             if (f.et.abort || f.e0.ctrl_c) // Should CTRL/C cause abort?
             {
@@ -110,20 +110,22 @@ void exec_T(struct cmd *cmd)
 
 static void exec_type(int_t m, int_t n)
 {
-    for (int_t i = m; i < n; ++i)
+    // Type out each contiguous block of text (there are at most two, one on
+    // each side of the gap) with a single call.
+
+    while (m < n)
     {
-        int c = getchar_ebuf(i);
+        uint_t nbytes = (uint_t)(n - m);
+        const char *p = getblock_ebuf(m, &nbytes);
 
-        if (c == EOF)
+        if (p == NULL)
         {
             break;
         }
-        else if (c == LF && f.e3.CR_type)
-        {
-            type_out(CR);
-        }
 
-        type_out(c);
+        type_text(p, nbytes);
+
+        m += nbytes;
     }
 }
 
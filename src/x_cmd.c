@@ -103,16 +103,22 @@ void exec_X(struct cmd *cmd)
         delete_qtext(cmd->qindex);
     }
 
-    for (int_t i = m; i < n; ++i)
+    // Copy the text in as few pieces as possible (normally no more than two,
+    // one on each side of the gap in the edit buffer).
+
+    for (int_t i = m; i < n; )
     {
-        int c = getchar_ebuf(i);
+        uint_t nbytes = (uint_t)(n - i);
+        const char *p = getblock_ebuf(i, &nbytes);
 
-        if (c == EOF)
+        if (p == NULL)
         {
             break;
         }
 
-        append_qchr(cmd->qindex, c);
+        append_qtext(cmd->qindex, p, nbytes);
+
+        i += (int_t)nbytes;
     }
 }
 